@@ -0,0 +1,87 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+#define ITERATIONS 100
+#define MAX_H 2048
+
+// Sync time against the size h of the h-relation. Every core sends h bytes
+// to the next core, as one put or as one get. This is measured with the
+// core copying the requests and with the DMA copying them, which is the
+// data needed to choose the threshold of ebsp_set_sync_dma.
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+    int n = bsp_nprocs();
+
+    static char src[MAX_H];
+    static char dst[MAX_H];
+    bsp_push_reg(src, MAX_H);
+    bsp_sync();
+
+    // Payloads of puts are staged in local memory,
+    // so the put phase copies from this core to the next core
+    ebsp_set_put_staging(MAX_H);
+
+    for (int h = 8; h <= MAX_H; h *= 2) {
+        ebsp_set_sync_dma(0);
+        ebsp_raw_time();
+        for (int i = 0; i < ITERATIONS; i++) {
+            bsp_put((p + 1) % n, dst, src, 0, h);
+            bsp_sync();
+        }
+        unsigned int put_cycles = ebsp_raw_time();
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            bsp_get((p + 1) % n, src, 0, dst, h);
+            bsp_sync();
+        }
+        unsigned int get_cycles = ebsp_raw_time();
+
+        ebsp_set_sync_dma(1);
+        ebsp_raw_time();
+        for (int i = 0; i < ITERATIONS; i++) {
+            bsp_put((p + 1) % n, dst, src, 0, h);
+            bsp_sync();
+        }
+        unsigned int put_dma_cycles = ebsp_raw_time();
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            bsp_get((p + 1) % n, src, 0, dst, h);
+            bsp_sync();
+        }
+        unsigned int get_dma_cycles = ebsp_raw_time();
+
+        if (p == 0)
+            ebsp_message("h = %d bytes: cycles per bsp_sync with a put %u "
+                         "(DMA %u), with a get %u (DMA %u)",
+                         h, put_cycles / ITERATIONS,
+                         put_dma_cycles / ITERATIONS, get_cycles / ITERATIONS,
+                         get_dma_cycles / ITERATIONS);
+    }
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+// Round trips done back-to-back, the host should be spinning
+#define BURST_ITERATIONS 1000
+
+// Round trips with some work in between, the host will have backed off
+#define IDLE_ITERATIONS 100
+#define IDLE_LOOP 200000
+
+int main() {
+    bsp_begin();
+
+    int s = bsp_pid();
+
+    // Warm up
+    ebsp_host_sync();
+
+    // ebsp_host_sync restarts the timer, so ebsp_raw_time can not be used
+    // around it. bsp_time keeps counting over the host syncs
+    float t_start = bsp_time();
+    for (int i = 0; i < BURST_ITERATIONS; i++)
+        ebsp_host_sync();
+    float burst_time = bsp_time() - t_start;
+
+    float idle_time = 0.0f;
+    for (int i = 0; i < IDLE_ITERATIONS; i++) {
+        volatile int busy = IDLE_LOOP;
+        while (busy--) {
+        }
+        t_start = bsp_time();
+        ebsp_host_sync();
+        idle_time += bsp_time() - t_start;
+    }
+
+    if (s == 0) {
+        ebsp_message("burst: %u cycles (%.2f us) per host sync",
+                     (unsigned)(burst_time * 600.0e6f / BURST_ITERATIONS),
+                     burst_time * 1.0e6f / BURST_ITERATIONS);
+        ebsp_message("after idle: %u cycles (%.2f us) per host sync",
+                     (unsigned)(idle_time * 600.0e6f / IDLE_ITERATIONS),
+                     idle_time * 1.0e6f / IDLE_ITERATIONS);
+    }
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include <host_bsp.h>
+#include <stdio.h>
+#include <time.h>
+
+int host_syncs = 0;
+
+void count_sync() { host_syncs++; }
+
+double seconds_between(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) * 1.0e-9;
+}
+
+int main(int argc, char** argv) {
+    bsp_init("e_host_sync_latency.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    ebsp_set_sync_callback(count_sync);
+
+    // Measure both wall time and the cpu time used by the host
+    // while the cores are running
+    struct timespec wall_start, wall_end, cpu_start, cpu_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+
+    ebsp_spmd();
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+
+    bsp_end();
+
+    double wall = seconds_between(&wall_start, &wall_end);
+    double cpu = seconds_between(&cpu_start, &cpu_end);
+
+    printf("host syncs: %d\n", host_syncs);
+    printf("wall time: %.4f s, host cpu time: %.4f s (%.1f%% of one core)\n",
+           wall, cpu, 100.0 * cpu / wall);
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include <host_bsp.h>
+#include <stdio.h>
+#include <time.h>
+
+// Number of jobs per mode, the first job of every mode is not counted
+#define JOBS 21
+
+// Time at which all cores were running, see e_startup.c
+struct timespec t_running;
+
+void record_running() { clock_gettime(CLOCK_MONOTONIC, &t_running); }
+
+double seconds_between(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) * 1.0e-9;
+}
+
+// Runs short jobs from bsp_init to bsp_end and prints the average time
+// of every phase
+void run_jobs(int fast_start, int argc, char** argv) {
+    ebsp_set_fast_start(fast_start);
+
+    double init = 0.0, begin = 0.0, first_run = 0.0, spmd = 0.0, end = 0.0;
+    for (int job = 0; job < JOBS; job++) {
+        struct timespec t0, t1, t2, t3, t4;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        bsp_init("e_startup.srec", argc, argv);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        bsp_begin(bsp_nprocs());
+        ebsp_set_sync_callback(record_running);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        ebsp_spmd();
+        clock_gettime(CLOCK_MONOTONIC, &t3);
+        bsp_end();
+        clock_gettime(CLOCK_MONOTONIC, &t4);
+
+        if (job == 0)
+            continue;
+        init += seconds_between(&t0, &t1);
+        begin += seconds_between(&t1, &t2);
+        first_run += seconds_between(&t2, &t_running);
+        spmd += seconds_between(&t2, &t3);
+        end += seconds_between(&t3, &t4);
+    }
+
+    int n = JOBS - 1;
+    printf("%s start, average of %d jobs:\n", fast_start ? "fast" : "normal",
+           n);
+    printf("  bsp_init:           %8.3f ms\n", 1000.0 * init / n);
+    printf("  bsp_begin:          %8.3f ms\n", 1000.0 * begin / n);
+    printf("  ebsp_spmd to run:   %8.3f ms\n", 1000.0 * first_run / n);
+    printf("  ebsp_spmd total:    %8.3f ms\n", 1000.0 * spmd / n);
+    printf("  bsp_end:            %8.3f ms\n", 1000.0 * end / n);
+    printf("  bsp_init to run:    %8.3f ms\n",
+           1000.0 * (init + begin + first_run) / n);
+}
+
+int main(int argc, char** argv) {
+    run_jobs(0, argc, argv);
+    run_jobs(1, argc, argv);
+    return 0;
+}
@@ -0,0 +1,56 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+#define ITERATIONS 1000
+
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+    int n = bsp_nprocs();
+
+    int value = 0;
+    bsp_push_reg(&value, sizeof(int));
+    bsp_sync();
+
+    ebsp_raw_time();
+    for (int i = 0; i < ITERATIONS; i++)
+        bsp_sync();
+    unsigned int empty_cycles = ebsp_raw_time();
+
+    // Every core puts one integer to the next core
+    for (int i = 0; i < ITERATIONS; i++) {
+        bsp_put((p + 1) % n, &p, &value, 0, sizeof(int));
+        bsp_sync();
+    }
+    unsigned int put_cycles = ebsp_raw_time();
+
+    if (p == 0)
+        ebsp_message("%d cores: %u cycles per bsp_sync, %u with one put", n,
+                     empty_cycles / ITERATIONS, put_cycles / ITERATIONS);
+
+    bsp_end();
+
+    return 0;
+}
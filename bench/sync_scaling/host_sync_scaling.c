@@ -0,0 +1,44 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+// Runs the benchmark on workgroups of increasing size, as far as the chip
+// allows. On the emulator, set EBSP_EMU_ROWS=8 and EBSP_EMU_COLS=8
+// to go up to 64 cores.
+int main(int argc, char** argv) {
+    int sizes[] = {4, 8, 16, 32, 64};
+
+    for (int i = 0; i < sizeof(sizes) / sizeof(int); i++) {
+        bsp_init("e_sync_scaling.srec", argc, argv);
+        if (sizes[i] > bsp_nprocs()) {
+            bsp_end();
+            break;
+        }
+        bsp_begin(sizes[i]);
+        ebsp_spmd();
+        bsp_end();
+    }
+
+    return 0;
+}
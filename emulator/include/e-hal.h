@@ -0,0 +1,126 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// The part of the Epiphany SDK e-hal that is used by the Epiphany BSP
+// library, implemented by the software emulator (see emulator/README.md).
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifndef EBSP_EMULATOR
+#define EBSP_EMULATOR
+#endif
+
+typedef enum {
+    E_OK = 0,
+    E_ERR = -1,
+    E_WARN = -2,
+} e_return_stat_t;
+
+typedef enum { E_FALSE = 0, E_TRUE = 1 } e_bool_t;
+
+// e_read and e_write accept both an e_epiphany_t and an e_mem_t
+// and use the first member to tell them apart
+typedef enum {
+    E_NULL = 0,
+    E_EPI_PLATFORM,
+    E_EPI_CHIP,
+    E_EPI_GROUP,
+    E_EPI_CORE,
+    E_EXT_MEM,
+    E_MAPPING,
+    E_SHM,
+} e_objtype_t;
+
+typedef struct {
+    off_t phy_base;
+    off_t page_base;
+    off_t page_offset;
+    size_t map_size;
+    off_t map_mask;
+    void* mapped_base;
+    void* base;
+    size_t size;
+} e_mmap_t;
+
+typedef struct {
+    e_objtype_t objtype;
+    unsigned id;
+    unsigned row;
+    unsigned col;
+    e_mmap_t mems;
+} e_core_t;
+
+typedef struct {
+    e_objtype_t objtype;
+    unsigned row;
+    unsigned col;
+    unsigned rows;
+    unsigned cols;
+    unsigned num_cores;
+    e_core_t** core;
+} e_epiphany_t;
+
+typedef struct {
+    e_objtype_t objtype;
+    off_t phy_base;
+    off_t page_base;
+    off_t page_offset;
+    size_t map_size;
+    off_t map_mask;
+    void* mapped_base;
+    void* base;
+    off_t ephy_base;
+    off_t emap_size;
+} e_mem_t;
+
+typedef struct {
+    e_objtype_t objtype;
+    unsigned row;
+    unsigned col;
+    unsigned rows;
+    unsigned cols;
+    int num_chips;
+    int num_emems;
+} e_platform_t;
+
+int e_init(char* hdf);
+int e_finalize();
+int e_get_platform_info(e_platform_t* platform);
+
+int e_open(e_epiphany_t* dev, unsigned row, unsigned col, unsigned rows,
+           unsigned cols);
+int e_close(e_epiphany_t* dev);
+
+int e_alloc(e_mem_t* mbuf, off_t offset, size_t size);
+int e_free(e_mem_t* mbuf);
+
+ssize_t e_read(void* dev, unsigned row, unsigned col, off_t from_addr,
+               void* buf, size_t size);
+ssize_t e_write(void* dev, unsigned row, unsigned col, off_t to_addr,
+                const void* buf, size_t size);
+
+int e_reset_system();
+int e_reset_group(e_epiphany_t* dev);
+int e_start_group(e_epiphany_t* dev);
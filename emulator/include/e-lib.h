@@ -0,0 +1,163 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// The part of the Epiphany SDK e-lib that is used by the Epiphany BSP
+// library, implemented by the software emulator (see emulator/README.md).
+// Constants have the same values as in the SDK.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef EBSP_EMULATOR
+#define EBSP_EMULATOR
+#endif
+
+typedef enum { E_FALSE = 0, E_TRUE = 1 } e_bool_t;
+
+typedef unsigned e_coreid_t;
+
+typedef struct {
+    unsigned group_row;
+    unsigned group_col;
+    unsigned group_rows;
+    unsigned group_cols;
+    unsigned core_row;
+    unsigned core_col;
+} e_group_config_t;
+
+extern e_group_config_t e_group_config;
+
+void* e_get_global_address(unsigned row, unsigned col, const void* ptr);
+e_coreid_t e_coreid_from_coords(unsigned row, unsigned col);
+
+//
+// Registers
+//
+
+typedef enum {
+    E_REG_CONFIG = 0xf0400,
+    E_REG_STATUS = 0xf0404,
+    E_REG_IMASK = 0xf0424,
+    E_REG_DMA1CONFIG = 0xf0520,
+    E_REG_DMA1STATUS = 0xf053c,
+} e_core_reg_id_t;
+
+unsigned e_reg_read(e_core_reg_id_t reg_id);
+void e_reg_write(e_core_reg_id_t reg_id, unsigned val);
+
+//
+// Interrupts
+// The emulator does not generate interrupts
+//
+
+typedef enum {
+    E_SYNC = 0,
+    E_SW_EXCEPTION = 1,
+    E_MEM_FAULT = 2,
+    E_TIMER0_INT = 3,
+    E_TIMER1_INT = 4,
+    E_MESSAGE_INT = 5,
+    E_DMA0_INT = 6,
+    E_DMA1_INT = 7,
+    E_USER_INT = 9,
+} e_irq_type_t;
+
+typedef void (*e_irq_handler_t)(int);
+
+void e_irq_attach(e_irq_type_t irq, e_irq_handler_t handler);
+void e_irq_mask(e_irq_type_t irq, e_bool_t state);
+void e_irq_global_mask(e_bool_t state);
+
+//
+// DMA
+// The emulated DMA engine runs its tasks in order, but only when the
+// program waits for one of them, see e_emu_dma_wait
+//
+
+#define E_DMA_ENABLE (1 << 0)
+#define E_DMA_MASTER (1 << 1)
+#define E_DMA_CHAIN (1 << 2)
+#define E_DMA_STARTUP (1 << 3)
+#define E_DMA_IRQEN (1 << 4)
+#define E_DMA_BYTE (0 << 5)
+#define E_DMA_HWORD (1 << 5)
+#define E_DMA_WORD (2 << 5)
+#define E_DMA_DWORD (3 << 5)
+#define E_DMA_MSGMODE (1 << 10)
+
+typedef struct {
+    unsigned config;
+    unsigned inner_stride;
+    unsigned count;
+    unsigned outer_stride;
+    void* src_addr;
+    void* dst_addr;
+} __attribute__((aligned(8))) e_dma_desc_t;
+
+extern unsigned dma_data_size[8];
+
+//
+// Barriers and mutexes
+//
+
+typedef volatile char e_barrier_t;
+
+void e_barrier_init(volatile e_barrier_t bar_array[],
+                    e_barrier_t* tgt_bar_array[]);
+void e_barrier(volatile e_barrier_t* bar_array, e_barrier_t* tgt_bar_array[]);
+
+typedef int e_mutex_t;
+typedef int e_mutexattr_t;
+
+#define MUTEXATTR_NULL ((e_mutexattr_t*)0)
+
+void e_mutex_init(unsigned row, unsigned col, e_mutex_t* mutex,
+                  e_mutexattr_t* attr);
+void e_mutex_lock(unsigned row, unsigned col, e_mutex_t* mutex);
+unsigned e_mutex_trylock(unsigned row, unsigned col, e_mutex_t* mutex);
+void e_mutex_unlock(unsigned row, unsigned col, e_mutex_t* mutex);
+
+//
+// Emulator specific
+// Used by the BSP library in place of platform specific instructions
+//
+
+// Stop the calling core (trap 3)
+void e_emu_halt_core() __attribute__((noreturn));
+
+// Stop all cores of the workgroup (MBKPT)
+void e_emu_halt_all_cores();
+
+// Called in busy-wait loops: gives up the timeslice
+// and stops the calling core when the workgroup was halted
+void e_emu_spin_wait();
+
+// Add a task to the DMA queue of the calling core
+void e_emu_dma_push(e_dma_desc_t* desc);
+
+// Run the DMA tasks of the calling core up to and including `desc`
+void e_emu_dma_wait(e_dma_desc_t* desc);
+
+// Start of the local memory that is available for ebsp_malloc
+void* e_emu_local_memory();
+size_t e_emu_local_memory_size();
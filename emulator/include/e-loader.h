@@ -0,0 +1,34 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "e-hal.h"
+
+// The emulator loads `executable` as a shared object,
+// which is what the Makefiles produce when EMULATOR is set
+int e_load_group(char* executable, e_epiphany_t* dev, unsigned row,
+                 unsigned col, unsigned rows, unsigned cols, e_bool_t start);
+
+// Emulator specific: the address of a symbol of the loaded e-program with
+// value `value` (as in the symbol table of the shared object), as seen by
+// core (0, 0). This is the address that e_read and e_write expect.
+void* e_emu_program_address(uintptr_t value);
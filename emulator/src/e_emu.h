@@ -0,0 +1,119 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// State shared between the host half (e_hal_emu.c) and the core half
+// (e_lib_emu.c) of the software emulator.
+//
+// Every emulated core is a thread running its own copy of the e-program,
+// which is built as a shared object. Loading a separate copy per core gives
+// every core its own globals (including the coredata of the BSP library),
+// just like every core on the chip has its own local memory.
+// A local address on one core is translated to the same location in the
+// copy of another core, which is what e_get_global_address does on the chip.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Default size of the emulated chip, equal to the Parallella-16
+// It can be changed with the environment variables EBSP_EMU_ROWS and
+// EBSP_EMU_COLS, up to the size of the 64-core Epiphany-IV
+#define E_EMU_ROWS 4
+#define E_EMU_COLS 4
+#define E_EMU_MAX_ROWS 8
+#define E_EMU_MAX_COLS 8
+#define E_EMU_FIRST_ROW 32
+#define E_EMU_FIRST_COL 8
+
+// Stands in for the part of local memory that is not used by the program
+// and is therefore available to ebsp_malloc
+#define E_EMU_LOCAL_MEMORY_SIZE 0x8000
+
+// Core registers (E_REG_*) are at these local addresses
+#define E_EMU_REGS_START 0xf0000
+#define E_EMU_REGS_SIZE 0x1000
+
+typedef struct {
+    int row;
+    int col;
+
+    // The copy of the e-program loaded for this core
+    // and the in-memory file it was loaded from
+    void* handle;
+    int fd;
+    uintptr_t image_base;
+
+    void* local_memory;
+    uint32_t regs[E_EMU_REGS_SIZE / sizeof(uint32_t)];
+
+    pthread_t thread;
+    int started;
+} e_emu_core_t;
+
+typedef struct {
+    // Position and size of the workgroup on the chip
+    int row;
+    int col;
+    int rows;
+    int cols;
+
+    // Size of one loaded copy of the e-program
+    size_t image_size;
+
+    // Set by bsp_abort (MBKPT) or by the host to stop all cores
+    volatile int halted;
+
+    // State of the workgroup barrier, see e_barrier
+    volatile int barrier_count;
+    volatile int barrier_generation;
+
+    e_emu_core_t core[E_EMU_MAX_ROWS][E_EMU_MAX_COLS];
+} e_emu_group_t;
+
+// The host calls this function of a loaded copy in the thread of the core,
+// right before it calls main()
+#define E_EMU_SETUP_SYMBOL "e_emu_setup"
+typedef void (*e_emu_setup_t)(e_emu_group_t* group, int row, int col);
+
+// Translate an address as seen by core (from_row, from_col) to the same
+// location on core (row, col). Addresses outside local memory (such as
+// external memory) are the same for every core and are returned unchanged.
+static inline void* e_emu_translate(e_emu_group_t* group, int from_row,
+                                    int from_col, int row, int col,
+                                    const void* ptr) {
+    e_emu_core_t* from = &group->core[from_row][from_col];
+    e_emu_core_t* to = &group->core[row][col];
+    uintptr_t p = (uintptr_t)ptr;
+
+    if (p >= from->image_base && p < from->image_base + group->image_size)
+        return (void*)(p - from->image_base + to->image_base);
+
+    uintptr_t local = (uintptr_t)from->local_memory;
+    if (p >= local && p < local + E_EMU_LOCAL_MEMORY_SIZE)
+        return (void*)(p - local + (uintptr_t)to->local_memory);
+
+    if (p >= E_EMU_REGS_START && p < E_EMU_REGS_START + E_EMU_REGS_SIZE)
+        return &to->regs[(p - E_EMU_REGS_START) / sizeof(uint32_t)];
+
+    return (void*)ptr;
+}
@@ -0,0 +1,437 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Host half of the software emulator, replaces e-hal and e-loader.
+
+#define _GNU_SOURCE
+#include "e_emu.h"
+#include <e-hal.h>
+#include <e-loader.h>
+#include "common.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static e_emu_group_t group;
+
+// External memory is mapped at the address that the cores use,
+// so that pointers into external memory are valid on the host and the cores
+static void* extmem = NULL;
+
+typedef int (*e_emu_main_t)();
+
+//
+// Cores
+//
+
+static void* _core_thread(void* arg) {
+    e_emu_core_t* core = (e_emu_core_t*)arg;
+
+    // Allows the host to stop a core that is stuck in a loop
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+
+    e_emu_setup_t setup =
+        (e_emu_setup_t)dlsym(core->handle, E_EMU_SETUP_SYMBOL);
+    e_emu_main_t main_function = (e_emu_main_t)dlsym(core->handle, "main");
+
+    setup(&group, core->row, core->col);
+    main_function();
+    return NULL;
+}
+
+// Stop all running cores
+// Cores that are waiting in the BSP library stop as soon as the workgroup
+// is halted. Cores that do not stop within a second are cancelled.
+static void _stop_cores() {
+    __atomic_store_n(&group.halted, 1, __ATOMIC_SEQ_CST);
+
+    for (int r = 0; r < E_EMU_MAX_ROWS; r++) {
+        for (int c = 0; c < E_EMU_MAX_COLS; c++) {
+            e_emu_core_t* core = &group.core[r][c];
+            if (!core->started)
+                continue;
+
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            if (pthread_timedjoin_np(core->thread, NULL, &deadline) != 0) {
+                fprintf(stderr, "WARNING: emulator had to cancel core %d.\n",
+                        r * group.cols + c);
+                pthread_cancel(core->thread);
+                pthread_join(core->thread, NULL);
+            }
+            core->started = 0;
+        }
+    }
+}
+
+static void _unload_cores() {
+    for (int r = 0; r < E_EMU_MAX_ROWS; r++) {
+        for (int c = 0; c < E_EMU_MAX_COLS; c++) {
+            e_emu_core_t* core = &group.core[r][c];
+            if (core->handle)
+                dlclose(core->handle);
+            if (core->fd > 0)
+                close(core->fd);
+            free(core->local_memory);
+            memset(core, 0, sizeof(e_emu_core_t));
+        }
+    }
+    group.image_size = 0;
+}
+
+typedef struct {
+    uintptr_t load_address;
+    uintptr_t start;
+    uintptr_t end;
+} _image_range;
+
+static int _find_image_range(struct dl_phdr_info* info, size_t size,
+                             void* data) {
+    _image_range* range = (_image_range*)data;
+    if (info->dlpi_addr != range->load_address)
+        return 0;
+    range->start = UINTPTR_MAX;
+    range->end = 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_LOAD)
+            continue;
+        uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+        uintptr_t end = start + phdr->p_memsz;
+        if (start < range->start)
+            range->start = start;
+        if (end > range->end)
+            range->end = end;
+    }
+    return 1;
+}
+
+// Load a private copy of the e-program for one core
+// dlopen only loads a file once, so every core gets its own in-memory file.
+// The file is kept open so that every copy is loaded from a different path.
+static int _load_core(e_emu_core_t* core, const char* image, size_t size) {
+    core->fd = memfd_create("e-program", MFD_CLOEXEC);
+    if (core->fd == -1)
+        return E_ERR;
+    if (write(core->fd, image, size) != (ssize_t)size)
+        return E_ERR;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", core->fd);
+    core->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (core->handle == NULL) {
+        fprintf(stderr, "ERROR: emulator could not load e-program: %s\n",
+                dlerror());
+        return E_ERR;
+    }
+
+    if (dlsym(core->handle, E_EMU_SETUP_SYMBOL) == NULL ||
+        dlsym(core->handle, "main") == NULL) {
+        fprintf(stderr, "ERROR: e-program was not built for the emulator.\n");
+        return E_ERR;
+    }
+
+    struct link_map* map;
+    if (dlinfo(core->handle, RTLD_DI_LINKMAP, &map) != 0)
+        return E_ERR;
+    _image_range range;
+    range.load_address = map->l_addr;
+    if (dl_iterate_phdr(_find_image_range, &range) == 0)
+        return E_ERR;
+    core->image_base = range.start;
+    group.image_size = range.end - range.start;
+
+    core->local_memory = calloc(1, E_EMU_LOCAL_MEMORY_SIZE);
+    if (core->local_memory == NULL)
+        return E_ERR;
+    return E_OK;
+}
+
+//
+// e-hal
+//
+
+int e_init(char* hdf) {
+    // External memory is kept between programs, like on the chip
+    if (extmem)
+        return E_OK;
+
+    extmem = mmap((void*)E_EXTMEM_ADDR, EXTMEM_SIZE, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (extmem == MAP_FAILED || extmem != (void*)E_EXTMEM_ADDR) {
+        fprintf(stderr,
+                "ERROR: emulator could not map external memory at %p.\n",
+                (void*)E_EXTMEM_ADDR);
+        if (extmem != MAP_FAILED)
+            munmap(extmem, EXTMEM_SIZE);
+        extmem = NULL;
+        return E_ERR;
+    }
+    return E_OK;
+}
+
+int e_finalize() {
+    _stop_cores();
+    _unload_cores();
+    return E_OK;
+}
+
+int e_reset_system() {
+    _stop_cores();
+    return E_OK;
+}
+
+// Reads the size of the emulated chip from the environment
+static int _chip_size(const char* name, int fallback, int max) {
+    const char* value = getenv(name);
+    if (value == NULL)
+        return fallback;
+    int size = atoi(value);
+    if (size < 1 || size > max) {
+        fprintf(stderr, "WARNING: emulator ignores %s=%s.\n", name, value);
+        return fallback;
+    }
+    return size;
+}
+
+int e_get_platform_info(e_platform_t* platform) {
+    platform->objtype = E_EPI_PLATFORM;
+    platform->row = E_EMU_FIRST_ROW;
+    platform->col = E_EMU_FIRST_COL;
+    platform->rows = _chip_size("EBSP_EMU_ROWS", E_EMU_ROWS, E_EMU_MAX_ROWS);
+    platform->cols = _chip_size("EBSP_EMU_COLS", E_EMU_COLS, E_EMU_MAX_COLS);
+    platform->num_chips = 1;
+    platform->num_emems = 1;
+    return E_OK;
+}
+
+int e_open(e_epiphany_t* dev, unsigned row, unsigned col, unsigned rows,
+           unsigned cols) {
+    e_platform_t platform;
+    e_get_platform_info(&platform);
+    if (row + rows > platform.rows || col + cols > platform.cols)
+        return E_ERR;
+
+    dev->objtype = E_EPI_GROUP;
+    dev->row = E_EMU_FIRST_ROW + row;
+    dev->col = E_EMU_FIRST_COL + col;
+    dev->rows = rows;
+    dev->cols = cols;
+    dev->num_cores = rows * cols;
+
+    // The local memory of an emulated core is not one contiguous block,
+    // so mems.base is not set. Use e_read and e_write instead.
+    dev->core = (e_core_t**)calloc(rows, sizeof(e_core_t*));
+    for (unsigned r = 0; r < rows; r++) {
+        dev->core[r] = (e_core_t*)calloc(cols, sizeof(e_core_t));
+        for (unsigned c = 0; c < cols; c++) {
+            e_core_t* core = &dev->core[r][c];
+            core->objtype = E_EPI_CORE;
+            core->row = dev->row + r;
+            core->col = dev->col + c;
+            core->id = (core->row << 6) | core->col;
+        }
+    }
+
+    group.row = dev->row;
+    group.col = dev->col;
+    group.rows = rows;
+    group.cols = cols;
+    return E_OK;
+}
+
+int e_close(e_epiphany_t* dev) {
+    for (unsigned r = 0; r < dev->rows; r++)
+        free(dev->core[r]);
+    free(dev->core);
+    dev->core = NULL;
+    return E_OK;
+}
+
+int e_alloc(e_mem_t* mbuf, off_t offset, size_t size) {
+    if (extmem == NULL || offset + size > EXTMEM_SIZE)
+        return E_ERR;
+    mbuf->objtype = E_EXT_MEM;
+    mbuf->phy_base = E_EXTMEM_ADDR + offset;
+    mbuf->ephy_base = E_EXTMEM_ADDR + offset;
+    mbuf->page_base = mbuf->phy_base;
+    mbuf->page_offset = 0;
+    mbuf->map_size = size;
+    mbuf->emap_size = size;
+    mbuf->map_mask = 0;
+    mbuf->base = (char*)extmem + offset;
+    mbuf->mapped_base = mbuf->base;
+    return E_OK;
+}
+
+int e_free(e_mem_t* mbuf) {
+    mbuf->base = NULL;
+    mbuf->mapped_base = NULL;
+    return E_OK;
+}
+
+// Host pointer for `size` bytes at address `addr` of `dev`
+// For a workgroup, `addr` is a local address as seen by core (0, 0),
+// which is also what the cores report to the host
+static void* _host_address(void* dev, unsigned row, unsigned col, off_t addr,
+                           size_t size) {
+    if (((e_mem_t*)dev)->objtype == E_EXT_MEM) {
+        e_mem_t* mem = (e_mem_t*)dev;
+        if (mem->base == NULL || addr + size > mem->map_size)
+            return NULL;
+        return (char*)mem->base + addr;
+    }
+
+    e_epiphany_t* group_dev = (e_epiphany_t*)dev;
+    if (row >= group_dev->rows || col >= group_dev->cols)
+        return NULL;
+    e_emu_core_t* first = &group.core[0][0];
+    uintptr_t p = (uintptr_t)addr;
+    uintptr_t local = (uintptr_t)first->local_memory;
+    int is_local =
+        (p >= first->image_base &&
+         p + size <= first->image_base + group.image_size) ||
+        (p >= local && p + size <= local + E_EMU_LOCAL_MEMORY_SIZE) ||
+        (p >= E_EMU_REGS_START && p + size <= E_EMU_REGS_START + E_EMU_REGS_SIZE);
+    if (!is_local)
+        return NULL;
+    return e_emu_translate(&group, 0, 0, row, col, (void*)addr);
+}
+
+ssize_t e_read(void* dev, unsigned row, unsigned col, off_t from_addr,
+               void* buf, size_t size) {
+    void* src = _host_address(dev, row, col, from_addr, size);
+    if (src == NULL)
+        return E_ERR;
+    memcpy(buf, src, size);
+    return size;
+}
+
+ssize_t e_write(void* dev, unsigned row, unsigned col, off_t to_addr,
+                const void* buf, size_t size) {
+    void* dst = _host_address(dev, row, col, to_addr, size);
+    if (dst == NULL)
+        return E_ERR;
+    memcpy(dst, buf, size);
+    __sync_synchronize();
+    return size;
+}
+
+int e_reset_group(e_epiphany_t* dev) {
+    _stop_cores();
+    return E_OK;
+}
+
+int e_start_group(e_epiphany_t* dev) {
+    _stop_cores();
+
+    group.halted = 0;
+    group.barrier_count = 0;
+    group.barrier_generation = 0;
+
+    for (unsigned r = 0; r < dev->rows; r++) {
+        for (unsigned c = 0; c < dev->cols; c++) {
+            e_emu_core_t* core = &group.core[r][c];
+            if (core->handle == NULL)
+                return E_ERR;
+            if (pthread_create(&core->thread, NULL, _core_thread, core) != 0)
+                return E_ERR;
+            core->started = 1;
+        }
+    }
+    return E_OK;
+}
+
+//
+// e-loader
+//
+
+int e_load_group(char* executable, e_epiphany_t* dev, unsigned row,
+                 unsigned col, unsigned rows, unsigned cols, e_bool_t start) {
+    _stop_cores();
+    _unload_cores();
+
+    // An SREC file can not be run, the shared object is the file with
+    // the same name and the extension .elf
+    char path[1024];
+    snprintf(path, sizeof(path), "%s", executable);
+    FILE* file = fopen(path, "rb");
+    if (file != NULL && fgetc(file) == 'S') {
+        fclose(file);
+        file = NULL;
+        char* extension = strrchr(path, '.');
+        if (extension != NULL &&
+            extension - path + sizeof(".elf") <= sizeof(path)) {
+            strcpy(extension, ".elf");
+            file = fopen(path, "rb");
+        }
+    }
+    if (file == NULL)
+        return E_ERR;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* image = malloc(size);
+    if (image == NULL || fread(image, 1, size, file) != (size_t)size) {
+        free(image);
+        fclose(file);
+        return E_ERR;
+    }
+    fclose(file);
+
+    int ret = E_OK;
+    for (unsigned r = row; r < row + rows && ret == E_OK; r++) {
+        for (unsigned c = col; c < col + cols && ret == E_OK; c++) {
+            e_emu_core_t* core = &group.core[r][c];
+            core->row = r;
+            core->col = c;
+            ret = _load_core(core, image, size);
+        }
+    }
+    free(image);
+
+    if (ret != E_OK) {
+        _unload_cores();
+        return E_ERR;
+    }
+
+    if (start == E_TRUE)
+        return e_start_group(dev);
+    return E_OK;
+}
+
+void* e_emu_program_address(uintptr_t value) {
+    struct link_map* map;
+    if (group.core[0][0].handle == NULL ||
+        dlinfo(group.core[0][0].handle, RTLD_DI_LINKMAP, &map) != 0)
+        return NULL;
+    return (void*)(map->l_addr + value);
+}
@@ -0,0 +1,204 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Core half of the software emulator, linked into every e-program.
+// Every core has its own copy of the globals in this file.
+
+#define _POSIX_C_SOURCE 200809L
+#include "e_emu.h"
+#include <e-lib.h>
+#include "e_bsp.h"
+#include "common.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+e_group_config_t e_group_config;
+
+static e_emu_group_t* group;
+static e_emu_core_t* self;
+
+// Queue of DMA tasks that did not run yet
+#define DMA_QUEUE_SIZE 16
+static e_dma_desc_t* dma_queue[DMA_QUEUE_SIZE];
+static int dma_queue_start;
+static int dma_queue_count;
+
+// Time of the last call to ebsp_raw_time
+static struct timespec timer_start;
+
+// Used to select the transfer size of a DMA task, indexed by alignment
+unsigned dma_data_size[8] = {E_DMA_DWORD, E_DMA_BYTE, E_DMA_HWORD, E_DMA_BYTE,
+                             E_DMA_WORD,  E_DMA_BYTE, E_DMA_HWORD, E_DMA_BYTE};
+
+void e_emu_setup(e_emu_group_t* _group, int row, int col) {
+    group = _group;
+    self = &group->core[row][col];
+
+    e_group_config.group_row = group->row;
+    e_group_config.group_col = group->col;
+    e_group_config.group_rows = group->rows;
+    e_group_config.group_cols = group->cols;
+    e_group_config.core_row = row;
+    e_group_config.core_col = col;
+
+    dma_queue_start = 0;
+    dma_queue_count = 0;
+    clock_gettime(CLOCK_MONOTONIC, &timer_start);
+}
+
+void* e_get_global_address(unsigned row, unsigned col, const void* ptr) {
+    return e_emu_translate(group, self->row, self->col, row, col, ptr);
+}
+
+e_coreid_t e_coreid_from_coords(unsigned row, unsigned col) {
+    return ((group->row + row) << 6) | (group->col + col);
+}
+
+unsigned e_reg_read(e_core_reg_id_t reg_id) {
+    return *(uint32_t*)e_get_global_address(self->row, self->col,
+                                            (void*)reg_id);
+}
+
+void e_reg_write(e_core_reg_id_t reg_id, unsigned val) {
+    *(uint32_t*)e_get_global_address(self->row, self->col, (void*)reg_id) =
+        val;
+}
+
+void e_irq_attach(e_irq_type_t irq, e_irq_handler_t handler) {}
+
+void e_irq_mask(e_irq_type_t irq, e_bool_t state) {}
+
+void e_irq_global_mask(e_bool_t state) {}
+
+// The barrier uses a counter and a generation that is increased by the
+// last core to arrive. The arrays of the chip implementation are not used.
+void e_barrier_init(volatile e_barrier_t bar_array[],
+                    e_barrier_t* tgt_bar_array[]) {
+    int n = group->rows * group->cols;
+    int pid = self->row * group->cols + self->col;
+    for (int i = 0; i < n; i++)
+        bar_array[i] = 0;
+    // Same targets as on the chip, the library writes to tgt_bar_array[0]
+    if (pid == 0) {
+        for (int i = 0; i < n; i++)
+            tgt_bar_array[i] = e_get_global_address(
+                i / group->cols, i % group->cols, (void*)&bar_array[0]);
+    } else {
+        tgt_bar_array[0] =
+            e_get_global_address(0, 0, (void*)&bar_array[pid]);
+    }
+}
+
+void e_barrier(volatile e_barrier_t* bar_array, e_barrier_t* tgt_bar_array[]) {
+    int generation = __atomic_load_n(&group->barrier_generation,
+                                     __ATOMIC_SEQ_CST);
+    int arrived =
+        __atomic_add_fetch(&group->barrier_count, 1, __ATOMIC_SEQ_CST);
+    if (arrived == group->rows * group->cols) {
+        __atomic_store_n(&group->barrier_count, 0, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&group->barrier_generation, generation + 1,
+                         __ATOMIC_SEQ_CST);
+        return;
+    }
+    while (__atomic_load_n(&group->barrier_generation, __ATOMIC_SEQ_CST) ==
+           generation)
+        e_emu_spin_wait();
+}
+
+void e_mutex_init(unsigned row, unsigned col, e_mutex_t* mutex,
+                  e_mutexattr_t* attr) {
+    e_mutex_t* m = e_get_global_address(row, col, mutex);
+    __atomic_store_n(m, 0, __ATOMIC_SEQ_CST);
+}
+
+unsigned e_mutex_trylock(unsigned row, unsigned col, e_mutex_t* mutex) {
+    e_mutex_t* m = e_get_global_address(row, col, mutex);
+    return __atomic_exchange_n(m, 1, __ATOMIC_ACQUIRE);
+}
+
+void e_mutex_lock(unsigned row, unsigned col, e_mutex_t* mutex) {
+    while (e_mutex_trylock(row, col, mutex) != 0)
+        e_emu_spin_wait();
+}
+
+void e_mutex_unlock(unsigned row, unsigned col, e_mutex_t* mutex) {
+    e_mutex_t* m = e_get_global_address(row, col, mutex);
+    __atomic_store_n(m, 0, __ATOMIC_RELEASE);
+}
+
+void e_emu_halt_core() { pthread_exit(NULL); }
+
+void e_emu_halt_all_cores() {
+    __atomic_store_n(&group->halted, 1, __ATOMIC_SEQ_CST);
+}
+
+void e_emu_spin_wait() {
+    if (__atomic_load_n(&group->halted, __ATOMIC_SEQ_CST))
+        e_emu_halt_core();
+    sched_yield();
+}
+
+// Run the oldest task in the DMA queue
+// The size follows from the descriptor, as set by _prepare_descriptor
+static void _dma_run_next() {
+    e_dma_desc_t* desc = dma_queue[dma_queue_start];
+    dma_queue_start = (dma_queue_start + 1) % DMA_QUEUE_SIZE;
+    dma_queue_count--;
+
+    size_t elementsize = 1 << ((desc->config >> 5) & 3);
+    size_t nbytes = (desc->count & 0xffff) * elementsize;
+    memcpy(desc->dst_addr, desc->src_addr, nbytes);
+    __atomic_and_fetch(&desc->config, ~E_DMA_ENABLE, __ATOMIC_SEQ_CST);
+}
+
+void e_emu_dma_push(e_dma_desc_t* desc) {
+    if (dma_queue_count == DMA_QUEUE_SIZE)
+        _dma_run_next();
+    dma_queue[(dma_queue_start + dma_queue_count) % DMA_QUEUE_SIZE] = desc;
+    dma_queue_count++;
+}
+
+void e_emu_dma_wait(e_dma_desc_t* desc) {
+    while ((desc->config & E_DMA_ENABLE) && dma_queue_count > 0)
+        _dma_run_next();
+}
+
+void* e_emu_local_memory() { return self->local_memory; }
+
+size_t e_emu_local_memory_size() { return E_EMU_LOCAL_MEMORY_SIZE; }
+
+// Replaces e_bsp_raw_time.s, the timer runs at CLOCKSPEED
+unsigned int ebsp_raw_time() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double cycles = ((now.tv_sec - timer_start.tv_sec) +
+                     (now.tv_nsec - timer_start.tv_nsec) * 1.0e-9) *
+                    CLOCKSPEED;
+    timer_start = now;
+    // The timer on the chip stops at zero
+    if (cycles >= 4294967295.0)
+        return 0xffffffff;
+    return (unsigned int)cycles;
+}
@@ -52,10 +52,12 @@ int main() {
     int fastmode = 1;
 
     // Allocate local buffers
+    // The second buffers are at the same address on every core,
+    // so they do not have to be registered
     ebsp_open_down_stream((void**)&a_data[0], 0);
-    a_data[1] = ebsp_malloc(CORE_BLOCK_BYTES);
+    a_data[1] = ebsp_sym_malloc(CORE_BLOCK_BYTES);
     ebsp_open_down_stream((void**)&b_data[0], 1);
-    b_data[1] = ebsp_malloc(CORE_BLOCK_BYTES);
+    b_data[1] = ebsp_sym_malloc(CORE_BLOCK_BYTES);
 
     ebsp_open_up_stream((void**)&c_data, 2);
 
@@ -69,18 +71,14 @@ int main() {
     // Register their locations
     bsp_push_reg(a_data[0], CORE_BLOCK_BYTES);
     bsp_sync();
-    bsp_push_reg(a_data[1], CORE_BLOCK_BYTES);
-    bsp_sync();
     bsp_push_reg(b_data[0], CORE_BLOCK_BYTES);
     bsp_sync();
-    bsp_push_reg(b_data[1], CORE_BLOCK_BYTES);
-    bsp_sync();
 
     // Obtain neighbor locations
     neighbor_a_data[0] = ebsp_get_direct_address(a_neighbor, a_data[0]);
-    neighbor_a_data[1] = ebsp_get_direct_address(a_neighbor, a_data[1]);
+    neighbor_a_data[1] = ebsp_sym_address(a_neighbor, a_data[1]);
     neighbor_b_data[0] = ebsp_get_direct_address(b_neighbor, b_data[0]);
-    neighbor_b_data[1] = ebsp_get_direct_address(b_neighbor, b_data[1]);
+    neighbor_b_data[1] = ebsp_sym_address(b_neighbor, b_data[1]);
 
     ebsp_dma_handle dma_handle_a;
     ebsp_dma_handle dma_handle_b;
@@ -21,6 +21,7 @@ see the files COPYING and COPYING.LESSER. If not, see
 */
 
 #include <e_bsp.h>
+#include <stdint.h>
 
 int n, p;
 
@@ -174,7 +175,7 @@ void get_initial_data(void* buffer, unsigned int* nbytes) {
             status = space;
 
         // Get message payload
-        bsp_move((void*)((int)buffer + offset), status);
+        bsp_move((char*)buffer + offset, status);
         offset += status;
 
         if (p == 0)
@@ -229,7 +230,8 @@ int localmem_test() {
     if (p == 0) {
         ebsp_message("Success: allocation failed after first succesfully "
                      "allocating %d = %p bytes.",
-                     first_fail * 0x100, (void*)(first_fail * 0x100));
+                     first_fail * 0x100,
+                     (void*)(uintptr_t)(first_fail * 0x100));
         ebsp_message("Stack is at = %p; malloc'ed data from %p to %p", &ptrs[0],
                      ptrs[0], ptrs[first_fail - 1] + 0x100);
     }
@@ -51,8 +51,8 @@ int main() {
             break;
 
         for (unsigned offset = 0; offset < a_size; offset += sizeof(int)) {
-            int ai = *((int*)((unsigned)a + offset));
-            int bi = *((int*)((unsigned)b + offset));
+            int ai = *((int*)((char*)a + offset));
+            int bi = *((int*)((char*)b + offset));
             sum += ai * bi;
         }
     }
@@ -47,8 +47,8 @@ int main(int argc, char** argv) {
     int n_big = l + bsp_nprocs() * (1 - big_chunk_nints);
 
     int current_chunk_nints = big_chunk_nints;
-    unsigned a_cursor = (unsigned)a;
-    unsigned b_cursor = (unsigned)b;
+    uintptr_t a_cursor = (uintptr_t)a;
+    uintptr_t b_cursor = (uintptr_t)b;
     for (int pid = 0; pid < bsp_nprocs(); pid++) {
         if (pid == n_big)
             current_chunk_nints = small_chunk_nints;
@@ -26,10 +26,13 @@ see the files COPYING and COPYING.LESSER. If not, see
 
 // #define DEBUG
 
-#define NPROCS 16
+// The largest supported workgroup, equal to the 64-core Epiphany-IV.
+// The tables in the communication buffer are sized for the cores that
+// are actually used, see ebsp_combuf_tables
+#define MAX_NPROCS 64
 
 // Every variable that is registered with bsp_push_reg
-// gives 16 addresses (the locations on the different cores).
+// gives one address per core (the locations on the different cores).
 // An address takes 4 bytes, and MAX_BSP_VARS is the maximum
 // amount of variables that can be registered so in total we need
 // NCORES * MAX_BSP_VARS * 4 bytes to save all this data
@@ -49,6 +52,13 @@ see the files COPYING and COPYING.LESSER. If not, see
 // See ebsp_data_request::nbytes
 #define DATA_PUT_BIT (1 << 31)
 
+// Size of the log of every core, see ebsp_log_record
+// A record holds at most LOG_ARG_WORDS words of arguments, a message with
+// more arguments continues in the next records, up to LOG_MAX_ARG_WORDS
+#define LOG_RECORDS 32
+#define LOG_ARG_WORDS 8
+#define LOG_MAX_ARG_WORDS 32
+
 // Structures that are shared between ARM and epiphany
 // need to use the same alignment
 // By default, the epiphany compiler will align structs
@@ -105,55 +115,137 @@ typedef struct {
     void* current_buffer;       // pointer (in e_core_mem) to current chunk
     void* next_buffer;          // pointer (in e_core_mem) to next chunk
     int is_down_stream; // is 1 if it is a down-stream, 0 if it is an up-stream
-    int _padding; // make sure struct is 8 byte aligned when packed in arrays
+    // Number of chunk slots of a stream that the host refills (down) or
+    // empties (up) while the core uses it, or 0. See
+    // ebsp_create_down_stream_from_fd and ebsp_create_up_stream_to_fd
+    int window;
+    int opened; // set by the core, a stream with a window is opened once
 } __attribute__((aligned(8))) ebsp_stream_descriptor;
 
+// Chunk size in the header of a slot of a window, while the slot holds
+// no chunk: the core read it (down) or the host emptied it (up)
+#define CHUNK_PENDING (-1)
+
+// Every ebsp_log call results in one or more ebsp_log_record
+// The core does not format the message: it stores the address of the
+// format string and the arguments, and the host formats them
+typedef struct {
+    const char* format; // address on the core
+    // Number of records of the message, the first one included, or 0 for
+    // the records that continue the arguments of the previous one
+    uint32_t nrecords;
+    // Arguments in the order of the format, where 8-byte arguments
+    // are 8-byte aligned. A width or precision given by an argument ('*')
+    // is stored as an int before the argument of the conversion.
+    uint32_t args[LOG_ARG_WORDS];
+} ebsp_log_record;
+
 // ebsp_combuf is a struct for epiphany <-> ARM communication
 // It is located in external memory. For more info see
 // https://github.com/buurlage-wits/epiphany-bsp/wiki/Memory-on-the-parallella
 
 typedef struct {
-    // Epiphany --> ARM communication
-    int8_t syncstate[NPROCS];
-    int8_t* syncstate_ptr; // Location on epiphany core
-    char msgbuf[128];      // shared by all cores (mutexed)
-    uint16_t interrupts[NPROCS];
-
     // ARM --> Epiphany
-    float remotetimer;
+    // The cores derive the host time from their own timer, see
+    // ebsp_host_time. The host only publishes these values when the
+    // cores are started and at every ebsp_host_sync
+    // The epoch is split in whole seconds and nanoseconds, so that it does
+    // not lose precision as the program runs longer
+    uint32_t host_epoch_sec;  // host time, whole seconds
+    uint32_t host_epoch_nsec; // host time, nanoseconds within the second
+    float seconds_per_cycle;  // nominal conversion factor for the core timer
     int32_t nprocs;
     int32_t tagsize; // Only for initial and final messages
-    int n_streams[NPROCS];
-    void* extmem_streams[NPROCS];
-    // void*               extmem_current_out_chunk[_NPROCS];
-    // int                 out_buffer_size[_NPROCS];
+    // Memory for ebsp_ext_malloc of this run (in e_core address space),
+    // which is one of two slots in batch mode, see ebsp_set_batch_mode
+    void* dynmem;
 
     // Epiphany <--> Epiphany
-    void* bsp_var_list[MAX_BSP_VARS][NPROCS];
     uint32_t bsp_var_counter;
-    ebsp_data_request data_requests[NPROCS][MAX_DATA_REQUESTS];
     ebsp_message_queue message_queue[2];
     ebsp_payload_buffer data_payloads; // used for put/get/send
-} ebsp_combuf;
 
-// Right after combuf there is the memory used for mallocs
-// all the way till the end of external memory
+    // Epiphany --> ARM communication
+    // syncstate_ptr, and the syncstate and interrupts tables that follow
+    // the struct, form the status block that the host polls continuously,
+    // so they have to stay together and should be kept as small as possible
+    int8_t* syncstate_ptr; // Location on epiphany core
+} ebsp_combuf;
 
 #pragma pack(pop)
 
+// The per-core tables of the communication buffer. They are placed right
+// after ebsp_combuf and are sized for the cores of the workgroup, so that
+// small workgroups do not pay for the largest chip.
+// The pointers are in the address space of whoever filled in the struct,
+// see ebsp_combuf_layout.
+typedef struct {
+    int ncores;                       // number of cores in the workgroup
+    int8_t* syncstate;                // [ncores]
+    uint16_t* interrupts;             // [ncores]
+    int* n_streams;                   // [ncores]
+    void** extmem_streams;            // [ncores]
+    uint32_t* log_head;               // [ncores], written by the cores
+    uint32_t* log_dropped;            // [ncores], written by the cores
+    uint32_t* log_tail;               // [ncores], written by the host
+    ebsp_data_request* data_requests; // [ncores][MAX_DATA_REQUESTS]
+    void** bsp_var_list;              // [MAX_BSP_VARS][ncores]
+    ebsp_log_record* log_records;     // [ncores][LOG_RECORDS]
+} ebsp_combuf_tables;
+
+// Round `offset` up to a multiple of `n`, which is a power of two
+#define EBSP_ALIGN(offset, n) (((offset) + (n)-1) & ~((n)-1))
+
+// Fills in `tables` for a communication buffer at `combuf` and a workgroup
+// of `ncores` cores. Returns the size of the communication buffer including
+// the tables; the memory for ebsp_ext_malloc starts right after it.
+static inline unsigned int ebsp_combuf_layout(ebsp_combuf_tables* tables,
+                                              void* combuf, int ncores) {
+    char* base = (char*)combuf;
+    unsigned int offset = sizeof(ebsp_combuf);
+    tables->ncores = ncores;
+    // The status block continues without padding after syncstate_ptr
+    tables->syncstate = (int8_t*)(base + offset);
+    offset = EBSP_ALIGN(offset + ncores * sizeof(int8_t), 2);
+    tables->interrupts = (uint16_t*)(base + offset);
+    offset = EBSP_ALIGN(offset + ncores * sizeof(uint16_t), 8);
+    tables->n_streams = (int*)(base + offset);
+    offset = EBSP_ALIGN(offset + ncores * sizeof(int), 8);
+    tables->extmem_streams = (void**)(base + offset);
+    offset = EBSP_ALIGN(offset + ncores * sizeof(void*), 8);
+    // The host reads log_head and log_dropped together
+    tables->log_head = (uint32_t*)(base + offset);
+    offset += ncores * sizeof(uint32_t);
+    tables->log_dropped = (uint32_t*)(base + offset);
+    offset += ncores * sizeof(uint32_t);
+    tables->log_tail = (uint32_t*)(base + offset);
+    offset = EBSP_ALIGN(offset + ncores * sizeof(uint32_t), 8);
+    tables->data_requests = (ebsp_data_request*)(base + offset);
+    offset += ncores * MAX_DATA_REQUESTS * sizeof(ebsp_data_request);
+    offset = EBSP_ALIGN(offset, 8);
+    tables->bsp_var_list = (void**)(base + offset);
+    offset = EBSP_ALIGN(offset + MAX_BSP_VARS * ncores * sizeof(void*), 8);
+    tables->log_records = (ebsp_log_record*)(base + offset);
+    offset += ncores * LOG_RECORDS * sizeof(ebsp_log_record);
+    offset = EBSP_ALIGN(offset, 8);
+    return offset;
+}
+
+// Right after the tables there is the memory used for mallocs
+// all the way till the end of external memory
+
 // For info on these external memory addresses, see
 // https://github.com/buurlage-wits/epiphany-bsp/wiki/Memory-on-the-parallella
 
 // Sizes within external memory
 #define EXTMEM_SIZE 0x02000000 // Total size, 32 MB
 #define NEWLIB_SIZE 0x01800000
-#define COMBUF_SIZE sizeof(ebsp_combuf)
-#define DYNMEM_SIZE (EXTMEM_SIZE - COMBUF_SIZE - NEWLIB_SIZE)
+// The combuf and the memory for mallocs share the rest, see
+// ebsp_combuf_layout for the size of the combuf
 
 // Epiphany addresses
 #define E_EXTMEM_ADDR 0x8e000000
 #define E_COMBUF_ADDR (E_EXTMEM_ADDR + NEWLIB_SIZE)
-#define E_DYNMEM_ADDR (E_EXTMEM_ADDR + NEWLIB_SIZE + COMBUF_SIZE)
 
 // Possible values for syncstate
 // They start at 1 so that 0 means that the variable was not initialized
@@ -172,3 +264,106 @@ typedef struct {
 // resulting in roughly 600 Mhz
 #define CLOCKSPEED 600000000.0f
 
+// Argument types of printf conversions, see ebsp_log_next_arg
+#define LOG_ARG_END 0  // there are no more conversions
+#define LOG_ARG_NONE 1 // a conversion without argument, such as %%
+#define LOG_ARG_INT 2
+#define LOG_ARG_LONG 3
+#define LOG_ARG_LLONG 4
+#define LOG_ARG_DOUBLE 5
+#define LOG_ARG_POINTER 6
+#define LOG_ARG_STRING 7
+#define LOG_ARG_LDOUBLE 8 // a long double, passed on as a double
+#define LOG_ARG_WSTRING 9 // %ls, the pointer is printed as the conversion
+
+// Finds the next conversion of the printf format at `*cursor`. Sets `*spec`
+// to its '%' and moves `*cursor` past it. Returns the type of its argument,
+// or LOG_ARG_END with `*spec` at the end of the format.
+// Sets `*stars` to the number of int arguments for the width and precision
+// ('*') that precede the argument of the conversion.
+static inline int ebsp_log_next_arg(const char** cursor, const char** spec,
+                                    int* stars) {
+    const char* p = *cursor;
+    while (*p != '\0' && *p != '%')
+        p++;
+    *spec = p;
+    *stars = 0;
+    if (*p == '\0') {
+        *cursor = p;
+        return LOG_ARG_END;
+    }
+    p++;
+
+    // Flags, width and precision
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '.' ||
+           *p == '*' || (*p >= '0' && *p <= '9')) {
+        if (*p == '*')
+            (*stars)++;
+        p++;
+    }
+    // Length modifiers, size_t and ptrdiff_t have the size of a long
+    int longs = 0;
+    int long_double = 0;
+    for (;; p++) {
+        if (*p == 'l' || *p == 'z' || *p == 't')
+            longs++;
+        else if (*p == 'j')
+            longs = 2;
+        else if (*p == 'L')
+            long_double = 1;
+        else if (*p != 'h')
+            break;
+    }
+    char conversion = *p;
+    if (conversion != '\0')
+        p++;
+    *cursor = p;
+
+    switch (conversion) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+        return longs == 0 ? LOG_ARG_INT
+                          : (longs == 1 ? LOG_ARG_LONG : LOG_ARG_LLONG);
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        return long_double ? LOG_ARG_LDOUBLE : LOG_ARG_DOUBLE;
+    case 'p':
+        return LOG_ARG_POINTER;
+    case 's':
+        return longs == 0 ? LOG_ARG_STRING : LOG_ARG_WSTRING;
+    default:
+        return LOG_ARG_NONE;
+    }
+}
+
+// Size in bytes of an argument of type `type`
+static inline int ebsp_log_arg_size(int type) {
+    switch (type) {
+    case LOG_ARG_INT:
+        return sizeof(int);
+    case LOG_ARG_LONG:
+        return sizeof(long);
+    case LOG_ARG_LLONG:
+        return sizeof(long long);
+    case LOG_ARG_DOUBLE:
+    case LOG_ARG_LDOUBLE:
+        return sizeof(double);
+    case LOG_ARG_POINTER:
+    case LOG_ARG_STRING:
+    case LOG_ARG_WSTRING:
+        return sizeof(void*);
+    default:
+        return 0;
+    }
+}
@@ -85,8 +85,8 @@ int bsp_pid();
  * The native Epiphany timer does not support time differences longer than
  * `UINT_MAX/(600000000)` which is roughly 7 seconds.
  *
- * If you want to measure longer time intervals, we suggest you use the
- * (less accurate) ebsp_host_time().
+ * If you want to measure longer time intervals, we suggest you use
+ * ebsp_host_time() in combination with ebsp_host_sync().
  *
  * @remarks Using this in combination with ebsp_raw_time() leads to unspecified
  * behaviour, you should only use one of these in your program.
@@ -114,13 +114,29 @@ float bsp_time();
 unsigned int ebsp_raw_time();
 
 /**
- * Obtain the time in seconds since bsp_begin() was called.
- * @return A floating point value with the number of seconds since bsp_begin()
+ * Obtain the time in seconds since the host started the program.
+ * @return A floating point value with the number of seconds since the
+ * program was started by ebsp_spmd()
+ *
+ * The host publishes its system time when the program is started and at
+ * every ebsp_host_sync(). In between, the time is derived from the
+ * Epiphany core timer, which does not require any communication with the
+ * host.
+ *
+ * The core timer is converted to seconds with its nominal clock speed and
+ * is not calibrated against the host clock, so the time can drift from the
+ * host clock between two host syncs. The return value is a float, so its
+ * resolution decreases as the program runs: it is about a microsecond
+ * after 10 seconds. Use bsp_time() or ebsp_raw_time() to measure short
+ * intervals precisely.
+ *
+ * Intervals of arbitrary length are supported as long as this function
+ * (or bsp_time()) is called at least every 7 seconds, or there is an
+ * ebsp_host_sync() in every such interval.
  *
- * This function uses the system clock of the host to obtain the elapsed time.
- * Because of varying amounts of latency this can be very inaccurate
- * (its precision is in the order of milliseconds), but it supports time
- * intervals of arbitrary length. 
+ * @remarks Like bsp_time(), this uses the internal Epiphany `E_CTIMER_0`
+ * timer, so using it in combination with ebsp_raw_time() leads to
+ * unspecified behaviour.
  */
 float ebsp_host_time();
 
@@ -134,9 +150,29 @@ float ebsp_host_time();
  * If only a synchronization is required, and you do not want the outstanding
  * communications and registrations to be resolved, then we suggest you use the
  * more efficient function ebsp_barrier()
+ *
+ * The core copies the requests itself, unless ebsp_set_sync_dma() lets
+ * the DMA engine copy the large ones.
  */
 void bsp_sync();
 
+/**
+ * Lets bsp_sync() copy large requests with the DMA engine.
+ * @param min_nbytes Requests of at least this many bytes are copied by the
+ *  DMA engine `E_DMA_1`, while the core copies the smaller ones. 0 turns
+ *  the DMA off, which is the default.
+ *
+ * Requests that are done by the DMA engine are queued behind DMA tasks of
+ * ebsp_dma_push() that are still running. Requests larger than 64 KB, and
+ * requests between two addresses on this core, are always copied by the
+ * core.
+ *
+ * @remarks The threshold at which the DMA engine is faster has not been
+ *  measured on the chip yet; bench/h_relation reports the cost of bsp_sync
+ *  with and without the DMA against the size of the requests.
+ */
+void ebsp_set_sync_dma(unsigned int min_nbytes);
+
 /**
  * Synchronizes cores without resolving outstanding communication.
  *
@@ -151,6 +187,17 @@ void ebsp_barrier();
  * This can be used in combination with the function ebsp_set_sync_callback()
  * for the host program to intervene in running programs on the Epiphany using
  * the host processor.
+ *
+ * All cores have to call this function. The host releases core 0, which
+ * then releases the other cores over the mesh, so the cost of the release
+ * does not grow with the number of cores.
+ *
+ * The cores take over the time that the host publishes at every host sync,
+ * see ebsp_host_time().
+ *
+ * @remarks This restarts the `E_CTIMER_0` timer like bsp_time() does, so
+ * the next call to ebsp_raw_time() only counts the clockcycles since this
+ * host sync.
  */
 void ebsp_host_sync();
 
@@ -219,20 +266,45 @@ void bsp_pop_reg(const void* variable);
  *  corresponding to the variable location `dst`
  * @param nbytes The number of bytes to be copied
  *
- * The data in src is copied to a buffer (currently in the inefficient
- * external memory)  at the moment bsp_put is called. Therefore the caller can
- * replace the data in src right after bsp_put returns.
- * When bsp_sync() is called, the data will be transferred from the buffer
- * to the destination at the other processor.
+ * The data in src is copied to a buffer at the moment bsp_put is called.
+ * Therefore the caller can replace the data in src right after bsp_put
+ * returns. When bsp_sync() is called, the data will be transferred from the
+ * buffer to the destination at the other processor.
+ *
+ * The buffer is in local memory when a staging buffer was set with
+ * ebsp_set_put_staging() and the data fits in what is left of it in this
+ * superstep. Otherwise it is in external memory.
+ *
+ * A bsp_put() that writes right after the destination of the previous
+ * bsp_put() (for example the next element of the same array) is merged with
+ * it, so it does not count towards the limit of requests per superstep.
  *
  * @remarks No warning is thrown when nbytes exceeds the size of the variable
  *          src.
- * @remarks The current implementation uses external memory which restrains
- *          the performance of this function greatly. We suggest you use
- *          bsp_hpput() wherever possible to ensure good performance.
+ * @remarks Using external memory restrains the performance of this function
+ *          greatly. We suggest you use ebsp_set_put_staging(), or bsp_hpput()
+ *          wherever possible, to ensure good performance.
  */
 void bsp_put(int pid, const void* src, void* dst, int offset, int nbytes);
 
+/**
+ * Set the size of the staging buffer for bsp_put() in local memory.
+ * @param nbytes The size of the buffer in bytes, or 0 to remove it
+ * @return 1 on success, 0 if the buffer could not be allocated
+ *
+ * The data of bsp_put() calls is copied to this buffer until it is full
+ * for the current superstep, and to external memory after that.
+ * At bsp_sync() it is then copied from local memory to the destination,
+ * without going through external memory twice.
+ * By default there is no staging buffer.
+ *
+ * This function has to be called before the first bsp_put() of a
+ * superstep, for example right after bsp_begin(). The buffer is allocated
+ * with ebsp_malloc(), so when it could not be allocated, there is no
+ * staging buffer.
+ */
+int ebsp_set_put_staging(unsigned int nbytes);
+
 /**
  * Copy data to another processor, unbuffered.
  * @param pid The pid of the target processor (this is allowed to be the id
@@ -270,6 +342,9 @@ void bsp_hpput(int pid, const void* src, void* dst, int offset, int nbytes);
  * No data transaction takes place until the next call to bsp_sync, at which
  * point the data will be copied from source to destination.
  *
+ * A bsp_get() that continues both the source and the destination of the
+ * previous bsp_get() is merged with it, like consecutive bsp_put() calls.
+ *
  * @remarks The official BSP standard dictates that first all the data of all
  * bsp_get() transactions is copied into a buffer, after which all the data is
  * written to the proper destinations. This would allow one to use bsp_get to
@@ -472,6 +547,8 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc);
  *  obtained multiple times. It gives you random access in the memory in
  *  the data stream.
  * @remarks This function has `O(jump_n_chunks)` complexity.
+ * @remarks Not supported for streams that are refilled by the host while
+ *  they are read, see ebsp_create_down_stream_from_fd().
  */
 void ebsp_move_down_cursor(int stream_id, int jump_n_chunks);
 
@@ -484,6 +561,8 @@ void ebsp_move_down_cursor(int stream_id, int jump_n_chunks);
  * stream is equal to the first chunk.
  *
  * @remarks This function has `O(1)` complexity.
+ * @remarks Not supported for streams that are refilled by the host while
+ *  they are read, see ebsp_create_down_stream_from_fd().
  */
 void ebsp_reset_down_cursor(int stream_id);
 
@@ -578,10 +657,35 @@ void* ebsp_ext_malloc(unsigned int nbytes);
  */
 void* ebsp_malloc(unsigned int nbytes);
 
+/**
+ * Allocate local memory at the same address on every core.
+ * @param nbytes The size of the memory block, equal on every core
+ * @return A pointer to the allocated memory, guaranteed to be 8-byte aligned,
+ * or zero on error.
+ *
+ * This function has to be called by all cores, in the same order and with
+ * the same size, as it waits for all cores. The memory is taken from the
+ * part of local memory that is free on every core, so the pointer is the
+ * same on every core and the memory of another core can be accessed through
+ * ebsp_sym_address() without registering it with bsp_push_reg().
+ *
+ * The cores agree on the result: when the allocation fails on one core,
+ * it returns zero on every core.
+ *
+ * The memory is released with ebsp_free(), on every core.
+ *
+ * Usage example:
+ * \code{.c}
+ * float* buffer = ebsp_sym_malloc(16 * sizeof(float));
+ * float* next_buffer = ebsp_sym_address((bsp_pid() + 1) % bsp_nprocs(), buffer);
+ * \endcode
+ */
+void* ebsp_sym_malloc(unsigned int nbytes);
+
 /**
  * Free allocated external or local memory.
- * @param ptr A pointer to memory previously allocated by ebsp_ext_malloc()
- *            or by ebsp_malloc()
+ * @param ptr A pointer to memory previously allocated by ebsp_ext_malloc(),
+ *            ebsp_malloc() or ebsp_sym_malloc()
  *
  * Note that the malloc functions can return null pointers on error, and
  * ebsp_free will crash on null pointers.
@@ -676,6 +780,20 @@ void ebsp_dma_wait(ebsp_dma_handle* desc);
  */
 void* ebsp_get_direct_address(int pid, const void* variable);
 
+/**
+ * Get a raw remote memory address for memory allocated by ebsp_sym_malloc()
+ * @param pid Remote core id
+ * @param ptr A pointer returned by ebsp_sym_malloc(), or a pointer into
+ *  that memory
+ * @return A pointer to the same location on core `pid`
+ *
+ * Memory from ebsp_sym_malloc() is at the same local address on every core,
+ * so this function only adds the coreid of `pid` to the address.
+ * It does not need bsp_push_reg() and does not look anything up, so it
+ * can be used like ebsp_get_direct_address() right after the allocation.
+ */
+void* ebsp_sym_address(int pid, const void* ptr);
+
 /**
  * Performs a memory copy completely analogous to the standard C memcpy().
  * @param dst    Destination address
@@ -698,20 +816,64 @@ void ebsp_memcpy(void* dst, const void* src, size_t nbytes);
  * Output a debug message printf style.
  * @param format The formatting string in printf style
  *
- * ebsp_message() outputs a debug message by sending it to shared memory
- * So that the host processor can output it to the terminal
+ * ebsp_message() outputs a debug message by writing it to the log of the
+ * core (see ebsp_log()) and waiting until the host has printed it to the
+ * terminal. The message is formatted by the host, with the restrictions
+ * of ebsp_log(), so printf is not linked into the program.
  * The attributes in this definition make sure that the compiler checks the
  * arguments for errors.
  */
 void ebsp_message(const char* format, ...)
     __attribute__((__format__(__printf__, 1, 2)));
 
+/**
+ * Output a debug message printf style, formatted by the host.
+ * @param format The formatting string in printf style
+ *
+ * ebsp_log() does not format the message and does not wait for the host.
+ * It only writes the address of `format` and the raw arguments to a log
+ * in external memory, which the host reads when it is idle, when a core
+ * calls ebsp_message() and when the cores finish. The host formats the
+ * message, reading the format and the strings from the memory of the core
+ * or from external memory, and prints it like ebsp_message() does. A call only walks the format string to copy the
+ * arguments instead of making a round trip to the host, so it can be used
+ * inside loops.
+ *
+ * Every core has a log of 32 messages. When the log is full, because the
+ * host did not read it yet, the message is dropped and the host reports
+ * how many messages were dropped.
+ *
+ * @remarks
+ * Messages of ebsp_log() are not ordered with respect to messages of
+ * ebsp_message() on other cores.
+ *
+ * @remarks
+ * The arguments take at most 128 bytes, where a `double` or `long long`
+ * takes 8 bytes and a width or precision given by an argument (`%*d`)
+ * takes 4 bytes. Conversions whose arguments do not fit are printed as
+ * they are. A `long double` is printed with the precision of a `double`,
+ * and wide strings (`%ls`) are not read from the core but printed as the
+ * conversion. A message with more than 32 bytes of arguments takes more
+ * than one of the 32 places in the log. The format and the `%s` arguments
+ * are read by the host when it prints the message, so they should not
+ * change afterwards; ebsp_message() waits for that.
+ *
+ * The attributes in this definition make sure that the compiler checks the
+ * arguments for errors.
+ */
+void ebsp_log(const char* format, ...)
+    __attribute__((__format__(__printf__, 1, 2)));
+
 /**
  * Aborts the program after outputting a message.
  * @param format The formatting string in printf style
  *
  * bsp_abort aborts the program after outputting a message.
  * This terminates all running epiphany-cores regardless of their status.
+ * The message is formatted by the host, with the restrictions of
+ * ebsp_log(), and printed after the messages that were logged before.
+ * The core waits until the message was printed before it aborts, so the
+ * format does not have to be a string literal.
  *
  * @remarks
  * After bsp_abort the cores are left in a state that does NOT allow them
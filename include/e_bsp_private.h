@@ -34,6 +34,43 @@ see the files COPYING and COPYING.LESSER. If not, see
 #define EXT_MEM_TEXT __attribute__((section("EBSP_TEXT")))
 #define EXT_MEM_RO __attribute__((section("EBSP_RO")))
 
+// End of the local memory of a core, the stack grows down from here
+#define LOCAL_MEMORY_END 0x8000
+
+// Size of the hash table of registered variables, see _get_remote_addr
+// It is at most half full, so that lookups stay short
+#define VAR_TABLE_SIZE (2 * MAX_BSP_VARS)
+
+// Workgroups of at most VAR_REMOTE_MAX_CORES cores keep the remote addresses
+// of the registered variables in local memory, see _cache_remote_addrs.
+// At 16 cores and MAX_BSP_VARS variables that takes at most 4 KB.
+#define VAR_REMOTE_MAX_CORES 16
+
+// Requests of at least coredata.sync_dma_min_bytes are done by DMA1 in
+// bsp_sync, smaller ones are copied by the cpu, see ebsp_set_sync_dma.
+// The DMA is off by default, since the gain has not been measured on the
+// chip yet; bench/h_relation reports the cost of both.
+// The count field of a descriptor limits a single DMA task to 64 KB.
+// bsp_sync cycles through SYNC_DMA_DESCRIPTORS descriptors (a power of two)
+#define SYNC_DMA_MAX_BYTES 0xffff
+#define SYNC_DMA_OFF (SYNC_DMA_MAX_BYTES + 1)
+#define SYNC_DMA_DESCRIPTORS 4
+
+// Platform specific instructions
+// The software emulator (see emulator/) replaces them by function calls
+// _spin_wait() is called in every loop that waits for another core or the host
+#ifdef EBSP_EMULATOR
+#define EBSP_INTERRUPT
+#define _halt_core() e_emu_halt_core()
+#define _halt_all_cores() e_emu_halt_all_cores()
+#define _spin_wait() e_emu_spin_wait()
+#else
+#define EBSP_INTERRUPT __attribute__((interrupt))
+#define _halt_core() __asm__("trap 3")
+#define _halt_all_cores() __asm__("MBKPT")
+#define _spin_wait()
+#endif
+
 // All internal bsp variables for this core
 // 8-bit variables (mutexes) are grouped together
 // to avoid unnecesary padding
@@ -44,14 +81,33 @@ typedef struct {
     int32_t pid;
     int32_t nprocs;
 
-    uint16_t coreids[NPROCS]; // pid to coreid mapping
+    uint16_t* coreids; // pid to coreid mapping
+
+    // Per-core tables of the combuf, as seen by this core
+    ebsp_combuf_tables tables;
+
+    // Start of the memory for ebsp_ext_malloc, set by the host
+    void* dynmem;
 
     // time_passed is epiphany cpu time (so not walltime) in seconds
     float time_passed;
+    float seconds_per_cycle;
+
+    // ebsp_host_time() returns host_epoch_sec + host_time_passed
+    // host_time_passed starts at the nanoseconds of the epoch and is reset
+    // when a new epoch is received from the host, so it stays small
+    uint32_t host_epoch_sec;
+    float host_time_passed;
 
-    // counter for ebsp_combuf::data_requests[pid]
+    // counter for ebsp_combuf_tables::data_requests[pid]
     uint32_t request_counter;
 
+    // Buffer in local memory for the payloads of bsp_put, see
+    // ebsp_set_put_staging. put_staging_used is reset by bsp_sync
+    char* put_staging;
+    uint32_t put_staging_size;
+    uint32_t put_staging_used;
+
     // message_index is an index into an epiphany<->epiphany queue and
     // when it reached the end, it is an index into the arm->epiphany queue
     uint32_t tagsize;
@@ -59,12 +115,25 @@ typedef struct {
     uint32_t read_queue_index;
     uint32_t message_index;
 
-    // bsp_sync barrier
-    volatile e_barrier_t sync_barrier[NPROCS];
-    e_barrier_t* sync_barrier_tgt[NPROCS];
+    // bsp_sync barrier, with an entry for every core of the workgroup
+    // These are allocated first in local memory, so that they are at
+    // the same address on every core
+    volatile e_barrier_t* sync_barrier;
+    e_barrier_t** sync_barrier_tgt;
 
-    // if this core has done a bsp_push_reg
+    // if this core has done a bsp_push_reg, and the slot of bsp_var_list
+    // that it added to the hash table or -1, see _cache_remote_addrs
     int8_t var_pushed;
+    int8_t var_pushed_slot;
+
+    // Open-addressed hash table from the address of a variable registered
+    // by this core to its slot in bsp_var_list, with VAR_TABLE_SIZE entries
+    // An entry is empty when its address is 0
+    const void** var_table_addr;
+    int8_t* var_table_slot;
+    // Remote addresses of every slot of bsp_var_list, with the coreid of a
+    // local address included, or NULL when they are read from bsp_var_list
+    uintptr_t** var_remote; // [MAX_BSP_VARS][nprocs]
 
     // Mutex is used for message_queue (send) and data_payloads (put)
     e_mutex_t payload_mutex;
@@ -72,6 +141,12 @@ typedef struct {
     // Mutex for ebsp_message
     e_mutex_t ebsp_message_mutex;
 
+    // Position in the log of this core, see ebsp_log
+    // log_tail is the position of the host as it was last read
+    uint32_t log_head;
+    uint32_t log_tail;
+    uint32_t log_dropped;
+
     // Mutex for ebsp_ext_malloc (internal malloc does not have mutex)
     e_mutex_t malloc_mutex;
 
@@ -85,10 +160,17 @@ typedef struct {
 
     // Start and end of chain of DMA descriptors
     // cur_dma_desc is updated in the interrupt when the DMA finishes a task
-    // last_dma_desc is updated in ebsp_dma_push
+    // last_dma_desc is updated in ebsp_dma_push, and cleared in the
+    // interrupt when the chain is finished
     e_dma_desc_t* cur_dma_desc;
     e_dma_desc_t* last_dma_desc;
 
+    // SYNC_DMA_DESCRIPTORS descriptors for the requests in bsp_sync, which
+    // are allocated by ebsp_set_sync_dma. They are not on the stack, since
+    // the chain can still point to them after bsp_sync returns
+    ebsp_dma_handle* sync_dma_descs;
+    unsigned int sync_dma_min_bytes; // SYNC_DMA_OFF when the DMA is not used
+
     // Global-space pointer to local DMA1CONFIG and DMA1STATUS cpu registers
     unsigned* dma1config;
     unsigned* dma1status;
@@ -101,4 +183,6 @@ extern ebsp_core_data coredata;
 // ebsp_combuf * const combuf = (ebsp_combuf*)E_COMBUF_ADDR;
 
 void _init_local_malloc();
+void _init_var_table();
+void _cache_remote_addrs(int slot);
 
@@ -47,6 +47,7 @@ see the files COPYING and COPYING.LESSER. If not, see
  *
  * - ebsp_set_tagsize()
  * - ebsp_send_down()
+ * - ebsp_send_down_many()
  * - ebsp_get_tagsize()
  * - ebsp_qsize()
  * - ebsp_get_tag()
@@ -81,6 +82,98 @@ int ebsp_write(int pid, void* src, off_t dst, int size);
  */
 int ebsp_read(int pid, off_t src, void* dst, int size);
 
+/**
+ * A transfer between the host and an Epiphany core,
+ * for use with ebsp_writev() and ebsp_readv().
+ */
+typedef struct {
+    int pid;        ///< The pid of the Epiphany processor
+    off_t address;  ///< The address as seen by the Epiphany core
+    void* buffer;   ///< A pointer to the data on the host
+    int size;       ///< The amount of bytes to be copied
+} ebsp_transfer;
+
+/**
+ * Write several buffers to the Epiphany processor.
+ * @param transfers An array of transfers, each writing `size` bytes from
+ * `buffer` to `address` on core `pid`
+ * @param count The number of transfers
+ * @return 1 on success, 0 if one of the transfers failed
+ *
+ * Equivalent to calling ebsp_write() for every transfer. The local memory
+ * of the cores is accessed directly when it is memory mapped.
+ */
+int ebsp_writev(const ebsp_transfer* transfers, int count);
+
+/**
+ * Read several buffers from the Epiphany processor.
+ * @param transfers An array of transfers, each reading `size` bytes from
+ * `address` on core `pid` into `buffer`
+ * @param count The number of transfers
+ * @return 1 on success, 0 if one of the transfers failed
+ *
+ * Equivalent to calling ebsp_read() for every transfer.
+ */
+int ebsp_readv(const ebsp_transfer* transfers, int count);
+
+/**
+ * Write the same data to every Epiphany core in use.
+ * @param src A pointer to the source data
+ * @param dst The destination address (as seen by the Epiphany cores)
+ * @param size The amount of bytes to be copied
+ * @return 1 on success, 0 on failure
+ *
+ * Equivalent to calling ebsp_write() for every pid.
+ */
+int ebsp_write_all(void* src, off_t dst, int size);
+
+/**
+ * Write data to a variable of the Epiphany program on one core.
+ * @param pid The pid of the target processor
+ * @param symbol The name of a global variable of the Epiphany program
+ * @param buf A pointer to the source data
+ * @param nbytes The amount of bytes to be copied, at most the size
+ * of the variable
+ * @return 1 on success, 0 on failure
+ *
+ * The address of the variable is looked up in the ELF file of the Epiphany
+ * program, which has the name given to bsp_init() with the extension
+ * `.srec` replaced by `.elf`. The data is written directly to the local
+ * memory of the core, so that the program finds it there when it starts.
+ *
+ * This function may be called after bsp_begin() and before ebsp_spmd(),
+ * or from the sync callback (see ebsp_set_sync_callback()) when the cores
+ * are waiting in ebsp_host_sync().
+ *
+ * Usage example:
+ * \code{.c}
+ * // In the Epiphany program: float matrix[64] = {1.0f};
+ * for (int s = 0; s < bsp_nprocs(); s++)
+ *     ebsp_preload(s, "matrix", &input[64 * s], 64 * sizeof(float));
+ * ebsp_spmd();
+ * \endcode
+ *
+ * @remarks The variable has to be in local memory and must not be in
+ * `.bss`, because `.bss` is cleared when the program starts. The compiler
+ * puts variables without an initial value, or with an initial value of
+ * zero, in `.bss`. Give the variable a nonzero initial value as above.
+ */
+int ebsp_preload(int pid, const char* symbol, const void* buf, int nbytes);
+
+/**
+ * Read data from a variable of the Epiphany program on one core.
+ * @param pid The pid of the source processor
+ * @param symbol The name of a global variable of the Epiphany program
+ * @param buf A pointer to a buffer receiving the data
+ * @param nbytes The amount of bytes to be copied, at most the size
+ * of the variable
+ * @return 1 on success, 0 on failure
+ *
+ * The counterpart of ebsp_preload(). It may be called after ebsp_spmd()
+ * returns and before bsp_end(), or from the sync callback.
+ */
+int ebsp_harvest(int pid, const char* symbol, void* buf, int nbytes);
+
 /**
  * Initializes the BSP system.
  * @param e_name A string with the srec binary name of the Epiphany program
@@ -134,9 +227,61 @@ void ebsp_set_end_callback(void (*cb)());
  * core)
  *
  * This function will block until the BSP kernel program is finished.
+ *
+ * ebsp_spmd() can be called again to run the loaded program another time,
+ * without calling bsp_begin(). The messages, streams and memory obtained
+ * with ebsp_ext_malloc() of a run are released by the first call to
+ * ebsp_send_down(), ebsp_send_down_many(), a stream creation function,
+ * ebsp_ext_malloc() or ebsp_spmd() after that run, so the results of a run
+ * have to be read before preparing the next one. The tagsize is kept.
+ *
+ * @remarks Global variables of the Epiphany program are not initialized
+ * again when it is started another time.
  */
 int ebsp_spmd();
 
+/**
+ * Starts the Epiphany program on the Epiphany cores without blocking.
+ * @return A handle for the run, or 0 on failure
+ *
+ * The cores are started in the calling thread. Their requests are handled
+ * by a thread owned by the library, which also calls the sync and end
+ * callbacks (see ebsp_set_sync_callback()).
+ *
+ * Until ebsp_spmd_wait() has returned, no other function of this library
+ * may be called except for ebsp_spmd_test(), and in batch mode the
+ * functions that prepare the next run (see ebsp_set_batch_mode()).
+ *
+ * Usage example:
+ * \code{.c}
+ * int run = ebsp_spmd_async();
+ * while (!ebsp_spmd_test(run))
+ *     prepare_next_input();
+ * ebsp_spmd_wait(run);
+ * \endcode
+ */
+int ebsp_spmd_async();
+
+/**
+ * Checks whether a run started by ebsp_spmd_async() has finished.
+ * @param handle The handle returned by ebsp_spmd_async()
+ * @return 1 if the run has finished, 0 if it is still running,
+ * -1 if `handle` is not valid
+ *
+ * This function does not block.
+ */
+int ebsp_spmd_test(int handle);
+
+/**
+ * Waits for a run started by ebsp_spmd_async() to finish.
+ * @param handle The handle returned by ebsp_spmd_async()
+ * @return 1 on success, 0 on failure, like ebsp_spmd()
+ *
+ * This function has to be called once for every run started by
+ * ebsp_spmd_async(), after which the handle is no longer valid.
+ */
+int ebsp_spmd_wait(int handle);
+
 /**
  * Loads the BSP program onto the Epiphany cores.
  * @param nprocs The number of processors to run on
@@ -153,8 +298,15 @@ int ebsp_spmd();
  * }
  * \endcode
  *
- * @remarks The current implementation only allows `nprocs` to be a multiple
- * of 4 on the 16-core Parallella. Other values of `nprocs` are rounded down.
+ * The program is loaded on the first rows of the chip, as many as are
+ * needed for `nprocs` cores, for example one row for `nprocs` = 4 on the
+ * 16-core Parallella. The other rows are not reset, loaded or started.
+ * Pids are numbered row by row over the full width of the chip, so pid `s`
+ * is on the same core as when the full chip is used.
+ *
+ * @remarks When `nprocs` is not a multiple of the number of columns of the
+ * chip, such as 5 on the 16-core Parallella, the last row has unused cores.
+ * These run bsp_begin() and then wait until the program is finished.
  */
 int bsp_begin(int nprocs);
 
@@ -178,6 +330,66 @@ int bsp_begin(int nprocs);
  */
 int bsp_end();
 
+/**
+ * Enables or disables the fast start mode.
+ * @param enabled 1 to enable fast start, 0 to disable it (the default)
+ *
+ * This is meant for programs that run many short jobs, each with
+ * bsp_init(), bsp_begin(), ebsp_spmd() and bsp_end(). In fast start mode:
+ * - the Epiphany program is parsed once and kept in host memory, so the
+ *   next bsp_begin() with the same (unchanged) file only copies it to the
+ *   cores,
+ * - bsp_init() and bsp_begin() do not reset the cores when all cores
+ *   finished the previous program.
+ *
+ * The setting is kept after bsp_end().
+ *
+ * @remarks Fast start is experimental. Writing the cached program and the
+ * workgroup configuration replaces e_load_group() and has not been
+ * validated on the chip yet. The emulator only checks the parsed SREC
+ * file against the ELF file of the program, it loads the program itself.
+ */
+void ebsp_set_fast_start(int enabled);
+
+/**
+ * Enables or disables the batch mode.
+ * @param enabled 1 to enable batch mode, 0 to disable it (the default)
+ * @return 1 on success, 0 on failure (before bsp_begin() or while an
+ * asynchronous run is active)
+ *
+ * This is meant for programs that process a sequence of batches, where the
+ * host prepares the input of a batch while the cores process the previous
+ * one. In batch mode, the memory for ebsp_ext_malloc() is split in two
+ * slots of half the size. Consecutive runs use alternating slots, and while
+ * a run started by ebsp_spmd_async() is active, the next run is prepared
+ * in the other slot:
+ * - ebsp_ext_malloc(), ebsp_free() and the functions that create streams
+ *   may be called before ebsp_spmd_wait(),
+ * - messages can only be sent with ebsp_send_down() after ebsp_spmd_wait().
+ *
+ * The streams and memory of a run are released by the first call to a
+ * preparing function after the next run was started, so the results of a
+ * run can be read until then. Its messages can be read until the next call
+ * to ebsp_send_down(), ebsp_send_down_many() or ebsp_spmd().
+ *
+ * Usage example:
+ * \code{.c}
+ * ebsp_set_batch_mode(1);
+ * prepare_batch(0);
+ * for (int i = 0; i < n; i++) {
+ *     int run = ebsp_spmd_async();
+ *     if (i + 1 < n)
+ *         prepare_batch(i + 1);
+ *     ebsp_spmd_wait(run);
+ *     read_results(i);
+ * }
+ * \endcode
+ *
+ * Anything that was prepared for the next run is released when the mode is
+ * changed. The setting is kept until bsp_end().
+ */
+int ebsp_set_batch_mode(int enabled);
+
 /**
  * Returns the number of available processors (Epiphany cores).
  * @return The number of available processors
@@ -218,6 +430,24 @@ void ebsp_set_tagsize(int* tag_bytes);
  */
 void ebsp_send_down(int pid, const void* tag, const void* payload, int nbytes);
 
+/**
+ * Send several messages to the Epiphany cores at once.
+ * @param count The number of messages
+ * @param pids An array of `count` pids of the target processors
+ * @param tags A buffer of `count` consecutive tags of `tagsize` bytes each
+ * @param payloads An array of `count` pointers to the data payloads
+ * @param nbytes An array of `count` payload sizes in bytes
+ *
+ * Equivalent to calling ebsp_send_down() for every message, but the space
+ * in the message queue is claimed once for all messages. Use this to send
+ * large initial data sets.
+ *
+ * Either all messages are sent, or none of them when they do not fit
+ * in the message queue.
+ */
+void ebsp_send_down_many(int count, const int* pids, const void* tags,
+                         const void* const* payloads, const int* nbytes);
+
 /**
  * Get the tagsize as set by the Epiphany program.
  * @return The tagsize in bytes
@@ -272,9 +502,15 @@ void ebsp_move(void* payload, int buffer_size);
  * @return The number of bytes of the payload data
  *
  * This is the faster alternative of ebsp_move(), as this function does
- * not copy the data but returns the pointers to it.
+ * not copy the data but returns the pointers to it. The pointers point
+ * into external memory and remain valid until the next run is prepared
+ * (see ebsp_spmd()) or bsp_end() is called.
  *
  * Use only for gathering result messages at the end of a BSP program.
+ *
+ * @remarks In earlier versions the pointers pointed into a copy of the
+ * messages in host memory, and stayed valid after bsp_end(). Use ebsp_move()
+ * or copy the data if it is needed after bsp_end() or in the next run.
  */
 int ebsp_hpmove(void** tag_ptr_buf, void** payload_ptr_buf);
 
@@ -295,6 +531,52 @@ int ebsp_hpmove(void** tag_ptr_buf, void** payload_ptr_buf);
 void ebsp_create_down_stream(const void* src, int dst_core_id, int nbytes,
                              int chunksize);
 
+/**
+ * Creates several down streams at once
+ *
+ * @param count The number of streams
+ * @param srcs An array of `count` pointers to the data of the streams.
+ * @param dst_core_ids An array of `count` receiving processor identifiers.
+ * @param nbytes An array of `count` stream sizes in bytes.
+ * @param chunksize The size in bytes of a single chunk, for all streams.
+ *  Must be at least 16.
+ *
+ * Equivalent to calling ebsp_create_down_stream() for every stream, in order.
+ * The data of all streams is copied in a single pass that is divided over
+ * several host threads. The threads are started by the first stream that
+ * is large enough and kept until bsp_end().
+ */
+void ebsp_create_down_streams(int count, const void* const* srcs,
+                              const int* dst_core_ids, const int* nbytes,
+                              int chunksize);
+
+/**
+ * Creates a down stream with data from a file
+ *
+ * @param fd A file descriptor of a file that can be mapped, such as a
+ *  regular file opened for reading.
+ * @param offset The position in the file where the stream starts.
+ * @param nbytes The total number of bytes of the stream.
+ * @param dst_core_id The processor identifier of the receiving core.
+ * @param chunksize The size in bytes of a single chunk. Must be at least 16.
+ * @return 1 on success, 0 on failure
+ *
+ * The file is mapped into memory and the chunks are copied from there
+ * into external memory, without reading the file into a buffer first.
+ * The file descriptor can be closed after this call.
+ *
+ * When the stream does not fit in external memory, it gets a window of
+ * about 1 MB that is refilled from the file by ebsp_spmd() while the core
+ * reads the stream, so the file can be larger than external memory.
+ * The core waits when it reads faster than the host refills the window.
+ *
+ * @remarks A stream with a window can only be read once, from the start
+ *  to the end: ebsp_move_down_cursor() and ebsp_reset_down_cursor() are
+ *  not supported and the stream can not be opened again.
+ */
+int ebsp_create_down_stream_from_fd(int fd, long long offset, long long nbytes,
+                                    int dst_core_id, int chunksize);
+
 /**
  * Creates an up stream
  *
@@ -307,3 +589,50 @@ void ebsp_create_down_stream(const void* src, int dst_core_id, int nbytes,
  * This function outputs an error if `chunksize` is less than 16.
  */
 void* ebsp_create_up_stream(int dst_core_id, int max_nbytes, int chunksize);
+
+/**
+ * Creates an up stream that is written to a file during the run
+ *
+ * @param src_core_id The processor identifier of the sending core.
+ * @param fd A file descriptor that is open for writing, such as a file or
+ *  a pipe.
+ * @param chunksize The maximum number of bytes of a single chunk that can be
+ *  sent up through this stream. Must be at least 16.
+ * @return 1 on success, 0 on failure
+ *
+ * The core uses the stream like any up stream. Instead of collecting the
+ * chunks in external memory until the run ends, a host thread writes every
+ * chunk to `fd` as soon as the core has sent it with ebsp_move_chunk_up(),
+ * while the cores continue. The stream uses about 1 MB of external memory,
+ * however much data is sent. The core waits when the host can not keep up.
+ *
+ * The file descriptor can be closed after this call. All chunks have been
+ * written when ebsp_spmd() returns.
+ *
+ * @remarks The last chunk is only written after the core has called
+ *  ebsp_close_up_stream() or ebsp_move_chunk_up() without prealloc.
+ *
+ * @remarks The stream can only be written once: it can not be opened
+ *  again after it was closed.
+ */
+int ebsp_create_up_stream_to_fd(int src_core_id, int fd, int chunksize);
+
+/**
+ * Creates an up stream that is passed to a function during the run
+ *
+ * @param src_core_id The processor identifier of the sending core.
+ * @param callback The function that receives the chunks, with the
+ *  processor identifier, the data and size of the chunk and `arg`.
+ * @param arg Passed to `callback`.
+ * @param chunksize The maximum number of bytes of a single chunk that can be
+ *  sent up through this stream. Must be at least 16.
+ * @return 1 on success, 0 on failure
+ *
+ * Like ebsp_create_up_stream_to_fd(), but calls `callback` for every chunk.
+ * The callback is called by a host thread while the cores run, and should
+ * copy the data since it is only valid during the call.
+ */
+int ebsp_create_up_stream_to_callback(
+    int src_core_id,
+    void (*callback)(int pid, const void* data, int nbytes, void* arg),
+    void* arg, int chunksize);
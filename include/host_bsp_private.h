@@ -28,8 +28,124 @@ see the files COPYING and COPYING.LESSER. If not, see
 #define __USE_XOPEN2K
 #define __USE_POSIX199309 1
 #include <time.h>
+#include <stddef.h>
+#include <pthread.h>
 
-#define MAX_N_STREAMS 1000
+// Size of the local memory of a core
+#define LOCAL_MEMORY_SIZE 0x8000
+
+// The part of the combuf that the host polls while the cores are running
+// starts at syncstate_ptr and ends after the interrupts table
+#define COMBUF_STATUS_OFFSET offsetof(ebsp_combuf, syncstate_ptr)
+
+// Host polling engine, see _poll_backoff
+// After the status block changed, the host spins for POLL_SPIN_ITERATIONS
+// polls, then yields its timeslice for POLL_YIELD_ITERATIONS polls and after
+// that sleeps with an interval that doubles up to POLL_MAX_SLEEP_US
+#define POLL_SPIN_ITERATIONS 2000
+#define POLL_YIELD_ITERATIONS 200
+#define POLL_MAX_SLEEP_US 256
+
+// Host worker threads, see _parallel_for
+#define MAX_WORKER_THREADS 8
+
+// Down streams are packed by the worker threads in tasks of this size
+#define PACK_TASK_BYTES (1 << 20)
+
+// Down streams from a file, see ebsp_create_down_stream_from_fd
+// A stream that does not fit in extmem gets a window of about
+// FILE_STREAM_WINDOW bytes, which is refilled while the core reads it.
+// The file is mapped in views of FILE_STREAM_VIEW bytes.
+#define FILE_STREAM_WINDOW (1 << 20)
+#define FILE_STREAM_VIEW (16 << 20)
+
+// Up streams with a sink, see ebsp_create_up_stream_to_fd
+// They also get a window of about FILE_STREAM_WINDOW bytes. The sink thread
+// writes at most SINK_BATCH chunks at once and sleeps SINK_SLEEP_US when
+// there was nothing to write.
+#define SINK_BATCH 64
+#define SINK_SLEEP_US 100
+
+// Dirty-region tracking of state.combuf, see _combuf_mark_dirty
+// Regions that are at most DIRTY_REGION_GAP bytes apart are merged,
+// because one larger write is cheaper than two small ones
+#define MAX_DIRTY_REGIONS 16
+#define DIRTY_REGION_GAP 64
+
+// Part of ebsp_combuf [start, end) that was changed by the host
+typedef struct {
+    int start;
+    int end;
+} ebsp_combuf_region;
+
+// A down stream whose window is refilled from a file by ebsp_spmd
+typedef struct {
+    int fd; // a duplicate of the file descriptor of the user
+    long long offset;
+    long long nbytes;
+    int max_chunksize;
+    long long nchunks;
+    long long next_chunk; // next chunk to write, nchunks is the terminator
+
+    char* slots; // window in extmem, see _window_chunk_size in e_bsp_buffer.c
+    int window;  // number of slots
+
+    // Part of the file that is mapped
+    char* view;
+    long long view_start;
+    size_t view_length;
+} ebsp_file_stream;
+
+// An up stream whose window is emptied into a sink during the run
+typedef struct {
+    int pid;
+    int fd; // a duplicate of the file descriptor of the user, or -1
+    void (*callback)(int pid, const void* data, int nbytes, void* arg);
+    void* arg;
+    int max_chunksize;
+
+    char* slots; // window in extmem, see _up_window_slot in e_bsp_buffer.c
+    int window;  // number of slots
+    int next_slot;
+} ebsp_sink_stream;
+
+// Stream descriptors of one core for the next run. The number of streams
+// is in state.tables.n_streams, the capacity grows when it is exceeded.
+typedef struct {
+    ebsp_stream_descriptor* descriptors;
+    int capacity;
+} ebsp_stream_vector;
+
+// Streams that the host serves while the cores run
+typedef struct {
+    // Down streams that are refilled from a file
+    ebsp_file_stream* file_streams;
+    int n_file_streams;
+
+    // Up streams that are emptied into a sink by the sink thread,
+    // see _start_sink_thread
+    ebsp_sink_stream* sink_streams;
+    int n_sink_streams;
+} ebsp_host_streams;
+
+// Host worker threads that run the jobs of _parallel_for. They are started
+// by the first job that has more than one index and stopped by bsp_end.
+typedef struct {
+    pthread_t threads[MAX_WORKER_THREADS - 1];
+    int nthreads; // 0 while the threads are not started
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; // a job was posted or the threads have to stop
+    pthread_cond_t done; // a thread finished its part of the job
+    int stop;
+
+    // The current job, indices are taken from `next` with an atomic add
+    void (*fn)(void*, int);
+    void* arg;
+    int count;
+    int next;
+    int job;     // number of the current job
+    int running; // threads that did not finish the current job yet
+} ebsp_worker_pool;
 
 /*
  *  Global BSP state
@@ -54,14 +170,26 @@ typedef struct {
 
     // Epiphany structure to describe external memory mmap info
     e_mem_t emem;
+    // The part of external memory before the combuf, with the EXT_MEM_RO
+    // data and the heap of the cores, for the log (see _drain_logs)
+    e_mem_t newlib;
 
     // memory-mapped pointers to external memory
     // They are the host-side version of E_XXX_ADDR in common.h
     void* host_combuf_addr;
     void* host_dynmem_addr;
 
-    // Local copy of ebsp_combuf to copy from and copy into.
-    ebsp_combuf combuf;
+    // Local copy of the combuf to copy from and copy into, including the
+    // per-core tables. It is allocated by bsp_begin for the workgroup.
+    ebsp_combuf* combuf;
+    ebsp_combuf_tables tables; // in the local copy
+    unsigned int combuf_size;
+    // Tagsize set by ebsp_set_tagsize before bsp_begin
+    int tagsize;
+    // Parts of the local copy that have to be written to extmem
+    // by ebsp_spmd
+    ebsp_combuf_region dirty_regions[MAX_DIRTY_REGIONS];
+    int n_dirty_regions;
     // For reading out the final queue after spmd
     int message_index;
 
@@ -77,8 +205,37 @@ typedef struct {
     // Timer storage
     struct timespec ts_start, ts_end;
 
-    // Buffer
-    ebsp_stream_descriptor buffered_streams[NPROCS][MAX_N_STREAMS];
+    // Polling engine
+    int poll_idle;     // polls since the status block last changed
+    int poll_sleep_us; // current sleep interval
+
+    // Asynchronous run, see ebsp_spmd_async
+    pthread_t spmd_thread;
+    int spmd_handle;   // handle of the run that was not waited for, or 0
+    int spmd_runs;     // number of asynchronous runs, used for handles
+    int spmd_finished; // set by the polling thread
+    int spmd_result;   // return value of the run
+
+    // Stream descriptors of every core of the workgroup
+    ebsp_stream_vector* stream_vectors;
+
+    // Streams served by the host, for the next run and for the run that
+    // was started last. They are handed over by ebsp_spmd, so that the
+    // next run can be prepared while the cores run.
+    ebsp_host_streams next_streams;
+    ebsp_host_streams run_streams;
+    pthread_t sink_thread;
+    int sink_stop;
+
+    // Host worker threads, see _parallel_for
+    ebsp_worker_pool workers;
+
+    // Batch mode, see ebsp_set_batch_mode
+    // The memory for ebsp_ext_malloc is split in two slots: a run uses
+    // one of them while the next run is prepared in the other one
+    int batch_mode;
+    int batch_slot;  // slot of the next run
+    int queues_used; // the message queues hold messages of the last run
 
 } bsp_state_t;
 
@@ -90,19 +247,55 @@ extern bsp_state_t state;
 int bsp_init(const char* _e_name, int argc, char** argv);
 int bsp_begin(int nprocs);
 int ebsp_spmd();
+int ebsp_spmd_async();
+int ebsp_spmd_test(int handle);
+int ebsp_spmd_wait(int handle);
+void _prepare_next_run();
+void _prepare_next_messages();
 int bsp_end();
+void ebsp_set_fast_start(int enabled);
+int ebsp_set_batch_mode(int enabled);
 int bsp_nprocs();
 
+/*
+ *  host_bsp_loader
+ */
+int _load_program(const char* path);
+
 /*
  *  host_bsp_memory
  */
 void ebsp_malloc_init();
+void* _dynmem_base(int slot);
 void* ebsp_ext_malloc(unsigned int nbytes);
+// Largest nbytes for which ebsp_ext_malloc succeeds, it does not allocate
+// and does not prepare the next run
+unsigned int ebsp_ext_largest_free();
 void ebsp_free(void* ptr);
 int ebsp_write(int pid, void* src, off_t dst, int size);
 int ebsp_read(int pid, off_t src, void* dst, int size);
+int ebsp_writev(const ebsp_transfer* transfers, int count);
+int ebsp_readv(const ebsp_transfer* transfers, int count);
+int ebsp_write_all(void* src, off_t dst, int size);
+int ebsp_preload(int pid, const char* symbol, const void* buf, int nbytes);
+int ebsp_harvest(int pid, const char* symbol, void* buf, int nbytes);
+const char* _program_string(uintptr_t address);
+int _program_bytes_match(uintptr_t address, const unsigned char* data,
+                         size_t nbytes);
+size_t _program_image_size();
 int _write_core_syncstate(int pid, int syncstate);
+int _write_core_syncstates(int count, int syncstate);
+int _write_syncstates(int first, int count, int8_t syncstate);
+int _read_status(int8_t* prev, uint64_t* changed);
 int _write_extmem(void* src, off_t offset, int size);
+off_t _combuf_offset(const void* ptr);
+void _combuf_mark_dirty(void* ptr, int size);
+int _combuf_flush();
+
+/*
+ *  host_bsp_log
+ */
+void _drain_logs();
 
 /*
  *  host_bsp_buffer
@@ -112,16 +305,33 @@ void ebsp_send_buffered(void* src, int dst_core_id, int nbytes,
 void ebsp_send_buffered_raw(void* src, int dst_core_id, int nbytes,
                             int max_chunksize);
 void* ebsp_get_buffered(int src_core_id, int nbytes, int max_chunksize);
-void _ebsp_add_stream(int dst_core_id, void* extmem_in_buffer, int nbytes,
-                      int max_chunksize, int is_instream);
+ebsp_stream_descriptor* _ebsp_add_stream(int dst_core_id,
+                                         void* extmem_in_buffer, int nbytes,
+                                         int max_chunksize, int is_instream);
+void ebsp_create_down_streams(int count, const void* const* srcs,
+                              const int* dst_core_ids, const int* nbytes,
+                              int max_chunksize);
 void ebsp_create_down_stream_raw(const void* src, int dst_core_id, int nbytes,
                                  int max_chunksize);
+int ebsp_create_down_stream_from_fd(int fd, long long offset, long long nbytes,
+                                    int dst_core_id, int max_chunksize);
+void _refill_file_streams();
+int ebsp_create_up_stream_to_fd(int src_core_id, int fd, int max_chunksize);
+int ebsp_create_up_stream_to_callback(
+    int src_core_id,
+    void (*callback)(int pid, const void* data, int nbytes, void* arg),
+    void* arg, int max_chunksize);
+int _start_sink_thread();
+void _stop_sink_thread();
+void _release_host_streams(ebsp_host_streams* streams);
 
 /*
  *  host_bsp_mp
  */
 void ebsp_set_tagsize(int* tag_bytes);
 void ebsp_send_down(int pid, const void* tag, const void* payload, int nbytes);
+void ebsp_send_down_many(int count, const int* pids, const void* tags,
+                         const void* const* payloads, const int* nbytes);
 int ebsp_get_tagsize();
 void ebsp_qsize(int* packets, int* accum_bytes);
 ebsp_message_header* _next_queue_message();
@@ -137,7 +347,11 @@ void ebsp_set_sync_callback(void (*cb)());
 void ebsp_set_end_callback(void (*cb)());
 void* _arm_to_e_pointer(void* ptr);
 void* _e_to_arm_pointer(void* ptr);
-void _update_remote_timer();
+void _update_host_epoch();
 void _microsleep(int microseconds);
+void _parallel_for(int count, void (*fn)(void*, int), void* arg);
+void _stop_workers();
+void _poll_reset();
+void _poll_backoff();
 void _get_p_coords(int pid, int* row, int* col);
 void init_application_path();
@@ -22,12 +22,15 @@ see the files COPYING and COPYING.LESSER. If not, see
 
 #include "e_bsp_private.h"
 #include <string.h>
-#include <stdio.h>
 #include <stdarg.h>
 
 ebsp_core_data coredata;
 
+const char err_sync_dma_memory[] EXT_MEM_RO =
+    "BSP ERROR: could not allocate the DMA descriptors of bsp_sync";
+
 void _write_syncstate(int8_t state);
+void _resync_host_time();
 
 void _int_isr(int);
 void _dma_interrupt(int);
@@ -36,23 +39,42 @@ void EXT_MEM_TEXT bsp_begin() {
     int row = e_group_config.core_row;
     int col = e_group_config.core_col;
     int cols = e_group_config.group_cols;
+    int ncores = e_group_config.group_rows * cols;
 
     // Initialize local data
     coredata.pid = col + cols * row;
     coredata.nprocs = combuf->nprocs;
     coredata.request_counter = 0;
+    coredata.put_staging = 0;
+    coredata.put_staging_size = 0;
+    coredata.put_staging_used = 0;
     coredata.var_pushed = 0;
     coredata.tagsize = combuf->tagsize;
     coredata.tagsize_next = coredata.tagsize;
     coredata.read_queue_index = 0;
     coredata.message_index = 0;
+    coredata.log_head = 0;
+    coredata.log_tail = 0;
+    coredata.log_dropped = 0;
     coredata.cur_dma_desc = NULL;
     coredata.last_dma_desc = NULL;
     coredata.dma1config =
         e_get_global_address(row, col, (void*)E_REG_DMA1CONFIG);
     coredata.dma1status =
         e_get_global_address(row, col, (void*)E_REG_DMA1STATUS);
-    coredata.local_nstreams = combuf->n_streams[coredata.pid];
+    ebsp_combuf_layout(&coredata.tables, combuf, ncores);
+    coredata.dynmem = combuf->dynmem;
+    coredata.local_nstreams = coredata.tables.n_streams[coredata.pid];
+
+    // The tables that depend on the number of cores are allocated before
+    // anything else, so that they are at the same address on every core
+    _init_local_malloc();
+    coredata.sync_barrier = ebsp_malloc(ncores * sizeof(e_barrier_t));
+    coredata.sync_barrier_tgt = ebsp_malloc(ncores * sizeof(e_barrier_t*));
+    coredata.coreids = ebsp_malloc(ncores * sizeof(uint16_t));
+    coredata.sync_dma_descs = 0;
+    coredata.sync_dma_min_bytes = SYNC_DMA_OFF;
+    _init_var_table();
 
     for (int s = 0; s < coredata.nprocs; s++)
         coredata.coreids[s] =
@@ -95,14 +117,12 @@ void EXT_MEM_TEXT bsp_begin() {
     // Enable interrupts globally
     e_irq_global_mask(E_FALSE);
 
-    _init_local_malloc();
-
     // Copy stream descriptors to local memory
     unsigned int nbytes =
-        combuf->n_streams[coredata.pid] * sizeof(ebsp_stream_descriptor);
+        coredata.local_nstreams * sizeof(ebsp_stream_descriptor);
     coredata.local_streams = ebsp_malloc(nbytes);
-    ebsp_memcpy(coredata.local_streams, combuf->extmem_streams[coredata.pid],
-                nbytes);
+    ebsp_memcpy(coredata.local_streams,
+                coredata.tables.extmem_streams[coredata.pid], nbytes);
 
     // Send &syncstate to ARM
     if (coredata.pid == 0)
@@ -111,8 +131,8 @@ void EXT_MEM_TEXT bsp_begin() {
 #ifdef DEBUG
     // Wait for ARM before starting
     _write_syncstate(STATE_EREADY);
-    while (coredata.syncstate != STATE_CONTINUE) {
-    }
+    while (coredata.syncstate != STATE_CONTINUE)
+        _spin_wait();
 #endif
     _write_syncstate(STATE_RUN);
 
@@ -120,14 +140,15 @@ void EXT_MEM_TEXT bsp_begin() {
 
     // Initialize epiphany timer
     coredata.time_passed = 0.0f;
+    coredata.seconds_per_cycle = combuf->seconds_per_cycle;
+    coredata.host_epoch_sec = combuf->host_epoch_sec;
+    coredata.host_time_passed = combuf->host_epoch_nsec * 1.0e-9f;
     ebsp_raw_time();
 
-    // If this core is not supposed to be used, make sure the workgroup barrier
-    // works.
-    // TODO for future release: write a simpler own version of e_barrier
-    // that works without the full workgroup, allowing multiple instances
-    // to run on the same epiphany chips instead of having these spinning
-    // unused cores
+    // The host opens the first ceil(nprocs / cols) full rows of the chip.
+    // When nprocs does not fill the last row, only the cores at the end of
+    // that row are left over; they keep taking part in the workgroup
+    // barrier.
     if (coredata.pid >= coredata.nprocs)
         for (;;)
             e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
@@ -136,7 +157,7 @@ void EXT_MEM_TEXT bsp_begin() {
 void bsp_end() {
     _write_syncstate(STATE_FINISH);
     // Finish execution
-    __asm__("trap 3");
+    _halt_core();
 }
 
 int bsp_nprocs() { return coredata.nprocs; }
@@ -144,34 +165,80 @@ int bsp_nprocs() { return coredata.nprocs; }
 int bsp_pid() { return coredata.pid; }
 
 float EXT_MEM_TEXT bsp_time() {
-    coredata.time_passed += ebsp_raw_time() / CLOCKSPEED;
+    float dt = ebsp_raw_time() * coredata.seconds_per_cycle;
+    coredata.time_passed += dt;
+    coredata.host_time_passed += dt;
     return coredata.time_passed;
 }
 
-float ebsp_host_time() { return combuf->remotetimer; }
+float EXT_MEM_TEXT ebsp_host_time() {
+    bsp_time();
+    return coredata.host_epoch_sec + coredata.host_time_passed;
+}
+
+// Called when the host has published a new epoch. This always restarts
+// the timer, also when ebsp_host_time() has not been called yet, so that
+// the timer can not overflow between two host syncs
+void EXT_MEM_TEXT _resync_host_time() {
+    bsp_time();
+    coredata.host_epoch_sec = combuf->host_epoch_sec;
+    coredata.host_time_passed = combuf->host_epoch_nsec * 1.0e-9f;
+}
 
 // Sync
+// The DMA engine can not copy between two addresses on this core
+static inline int _on_this_core(const void* ptr) {
+    unsigned coreid = ((uintptr_t)ptr) >> 20;
+    return coreid == 0 || coreid == coredata.coreids[coredata.pid];
+}
+
 void bsp_sync() {
     // Handle all bsp_get requests before bsp_put request. They are stored in
     // the same list and recognized by the highest bit of nbytes
 
+    // Large requests are pushed to DMA1 and the cpu copies the small ones
+    // while the DMA is busy. The DMA handles its tasks in order, so waiting
+    // for the last one waits for all of them. The get phase has to be
+    // finished before the barrier, the put phase before the final barrier.
+    ebsp_dma_handle* descs = coredata.sync_dma_descs;
+    ebsp_dma_handle* last_desc = 0;
+    int dma_count = 0;
+
     // Instead of copying the code twice, we put it in a loop
     // so that the code is shorter (this is tested)
-    ebsp_data_request* reqs = &combuf->data_requests[coredata.pid][0];
+    ebsp_data_request* reqs =
+        &coredata.tables.data_requests[coredata.pid * MAX_DATA_REQUESTS];
     for (int put = 0;;) {
         e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
         for (int i = 0; i < coredata.request_counter; ++i) {
             int nbytes = reqs[i].nbytes;
             // Check if this is a get or a put
-            if ((nbytes & DATA_PUT_BIT) == put)
-                ebsp_memcpy(reqs[i].dst, reqs[i].src, nbytes & ~DATA_PUT_BIT);
+            if ((nbytes & DATA_PUT_BIT) != put)
+                continue;
+            nbytes &= ~DATA_PUT_BIT;
+            void* dst = reqs[i].dst;
+            const void* src = reqs[i].src;
+            if (nbytes >= coredata.sync_dma_min_bytes &&
+                nbytes <= SYNC_DMA_MAX_BYTES &&
+                !(_on_this_core(dst) && _on_this_core(src))) {
+                // Reuse a descriptor only after its previous task is done
+                last_desc = &descs[dma_count++ & (SYNC_DMA_DESCRIPTORS - 1)];
+                if (dma_count > SYNC_DMA_DESCRIPTORS)
+                    ebsp_dma_wait(last_desc);
+                ebsp_dma_push(last_desc, dst, src, nbytes);
+            } else {
+                ebsp_memcpy(dst, src, nbytes);
+            }
         }
-        if (put == 0)
+        if (put == 0) {
+            if (last_desc)
+                ebsp_dma_wait(last_desc);
             put = DATA_PUT_BIT;
-        else
+        } else
             break;
     }
     coredata.request_counter = 0;
+    coredata.put_staging_used = 0;
 
     // This can be done at any point during the sync
     // (as long as it is after the first barrier and before the last one
@@ -185,6 +252,7 @@ void bsp_sync() {
 
     if (coredata.var_pushed) {
         coredata.var_pushed = 0;
+        _cache_remote_addrs(coredata.var_pushed_slot);
         if (coredata.pid == 0)
             combuf->bsp_var_counter++;
     }
@@ -192,78 +260,209 @@ void bsp_sync() {
     coredata.tagsize = coredata.tagsize_next;
     coredata.message_index = 0;
 
+    // The puts ran on the DMA during the bookkeeping above
+    if (last_desc)
+        ebsp_dma_wait(last_desc);
+
     e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
 }
 
+void EXT_MEM_TEXT ebsp_set_sync_dma(unsigned int min_nbytes) {
+    if (min_nbytes == 0 || min_nbytes > SYNC_DMA_MAX_BYTES) {
+        coredata.sync_dma_min_bytes = SYNC_DMA_OFF;
+        return;
+    }
+    // The descriptors are kept when the DMA is turned off again
+    if (coredata.sync_dma_descs == 0) {
+        coredata.sync_dma_descs =
+            ebsp_malloc(SYNC_DMA_DESCRIPTORS * sizeof(ebsp_dma_handle));
+        if (coredata.sync_dma_descs == 0) {
+            ebsp_message(err_sync_dma_memory);
+            return;
+        }
+    }
+    coredata.sync_dma_min_bytes = min_nbytes;
+}
+
 void ebsp_barrier() {
     e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
 }
 
+// The host only releases core 0, which releases
+// the other cores through the workgroup barrier
 void ebsp_host_sync() {
     _write_syncstate(STATE_SYNC);
-    while (coredata.syncstate != STATE_CONTINUE) {
-    }
+    if (coredata.pid == 0)
+        while (coredata.syncstate != STATE_CONTINUE)
+            _spin_wait();
+    e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
     _write_syncstate(STATE_RUN);
+    _resync_host_time();
 }
 
 void _write_syncstate(int8_t state) {
     coredata.syncstate = state;              // local variable
-    combuf->syncstate[coredata.pid] = state; // being polled by ARM
+    coredata.tables.syncstate[coredata.pid] = state; // being polled by ARM
 }
 
-void __attribute__((interrupt)) _int_isr(int unusedargument) {
+void EBSP_INTERRUPT _int_isr(int unusedargument) {
+#ifndef EBSP_EMULATOR
     __asm__(
         "movfs r0, ipend"); // moves IPEND into r0 which is the first argument
-    combuf->interrupts[coredata.pid] = unusedargument;
+#endif
+    coredata.tables.interrupts[coredata.pid] = unusedargument;
     return;
 }
 
-void EXT_MEM_TEXT ebsp_send_string(const char* string) {
-    // Lock mutex
-    e_mutex_lock(0, 0, &coredata.ebsp_message_mutex);
-    // Write the message
-    ebsp_memcpy(&combuf->msgbuf[0], string, sizeof(combuf->msgbuf));
+// Copies the arguments of `format` to `words` with va_arg, in the layout
+// that the host expects, see ebsp_log_record. 8-byte arguments are 8-byte
+// aligned. Copying stops when LOG_MAX_ARG_WORDS words are full.
+// Returns the number of words that were used.
+static int _log_pack_args(uint32_t* words, const char* format,
+                          va_list args) {
+    char* dst = (char*)words;
+    unsigned int pos = 0;
+    const char* spec;
+    int type, stars;
+    while ((type = ebsp_log_next_arg(&format, &spec, &stars)) !=
+           LOG_ARG_END) {
+        int nbytes = ebsp_log_arg_size(type);
+        unsigned int end = pos + stars * sizeof(int);
+        if (nbytes == 8)
+            end = EBSP_ALIGN(end, 8);
+        if (end + nbytes > LOG_MAX_ARG_WORDS * sizeof(uint32_t))
+            break;
+        for (; stars > 0; stars--) {
+            int star = va_arg(args, int);
+            ebsp_memcpy(dst + pos, &star, sizeof(int));
+            pos += sizeof(int);
+        }
+        if (nbytes == 0)
+            continue;
+        pos = end;
+        union {
+            int i;
+            long l;
+            long long ll;
+            double d;
+            const void* p;
+        } value;
+        switch (type) {
+        case LOG_ARG_INT:
+            value.i = va_arg(args, int);
+            break;
+        case LOG_ARG_LONG:
+            value.l = va_arg(args, long);
+            break;
+        case LOG_ARG_LLONG:
+            value.ll = va_arg(args, long long);
+            break;
+        case LOG_ARG_DOUBLE:
+            value.d = va_arg(args, double);
+            break;
+        case LOG_ARG_LDOUBLE:
+            value.d = va_arg(args, long double);
+            break;
+        default:
+            value.p = va_arg(args, const void*);
+            break;
+        }
+        ebsp_memcpy(dst + pos, &value, nbytes);
+        pos += nbytes;
+    }
+    return (pos + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+}
+
+// Writes a message to the log of this core, see ebsp_log
+// The arguments were packed by _log_pack_args into `nwords` words, which
+// take one record for every LOG_ARG_WORDS words
+// Returns 0 when the log does not have room for the records
+static int _log_write(const char* format, const uint32_t* words, int nwords) {
+    uint32_t nrecords = 1;
+    if (nwords > LOG_ARG_WORDS)
+        nrecords = (nwords + LOG_ARG_WORDS - 1) / LOG_ARG_WORDS;
+    uint32_t head = coredata.log_head;
+    if (head - coredata.log_tail + nrecords > LOG_RECORDS) {
+        // The position of the host is only read when the log looks full
+        coredata.log_tail = coredata.tables.log_tail[coredata.pid];
+        if (head - coredata.log_tail + nrecords > LOG_RECORDS)
+            return 0;
+    }
+
+    for (uint32_t r = 0; r < nrecords; r++) {
+        ebsp_log_record* record =
+            &coredata.tables.log_records[coredata.pid * LOG_RECORDS +
+                                         (head + r) % LOG_RECORDS];
+        record->format = format;
+        record->nrecords = (r == 0) ? nrecords : 0;
+        int count = nwords - r * LOG_ARG_WORDS;
+        if (count > LOG_ARG_WORDS)
+            count = LOG_ARG_WORDS;
+        if (count > 0)
+            ebsp_memcpy(record->args, words + r * LOG_ARG_WORDS,
+                        count * sizeof(uint32_t));
+    }
+
+    // The records have to be written before the host sees the new head
+    __asm__ __volatile__("" ::: "memory");
+    coredata.log_head = head + nrecords;
+    coredata.tables.log_head[coredata.pid] = head + nrecords;
+    return 1;
+}
 
-    // Wait for message to be written
+void ebsp_log(const char* format, ...) {
+    uint32_t words[LOG_MAX_ARG_WORDS];
+    va_list args;
+    va_start(args, format);
+    int nwords = _log_pack_args(words, format, args);
+    va_end(args);
+    if (!_log_write(format, words, nwords))
+        coredata.tables.log_dropped[coredata.pid] = ++coredata.log_dropped;
+}
+
+// Waits until the host printed the log of this core
+static void EXT_MEM_TEXT _wait_for_log_print() {
     _write_syncstate(STATE_MESSAGE);
-    while (coredata.syncstate != STATE_CONTINUE) {
-    };
+    while (coredata.syncstate != STATE_CONTINUE)
+        _spin_wait();
     _write_syncstate(STATE_RUN);
+}
 
-    // Unlock mutex
-    e_mutex_unlock(0, 0, &coredata.ebsp_message_mutex);
+// Writes a message to the log and waits until the host printed it, so that
+// the host reads the format and the strings while they are still valid
+// The caller holds ebsp_message_mutex
+static void EXT_MEM_TEXT _log_print(const char* format, va_list args) {
+    uint32_t words[LOG_MAX_ARG_WORDS];
+    int nwords = _log_pack_args(words, format, args);
+    // When the log is full, the host empties it first
+    while (!_log_write(format, words, nwords))
+        _wait_for_log_print();
+    _wait_for_log_print();
 }
 
 void EXT_MEM_TEXT bsp_abort(const char* format, ...) {
-    // Because of the way these arguments work we can not
-    // simply call ebsp_message here
-    // so this function contains a copy of ebsp_message
-
-    // Write the message to a buffer
-    char buf[128];
+    // The message goes through the log like ebsp_message does. The mutex is
+    // never released, the cores are halted below.
+    e_mutex_lock(0, 0, &coredata.ebsp_message_mutex);
     va_list args;
     va_start(args, format);
-    vsnprintf(&buf[0], sizeof(buf), format, args);
+    _log_print(format, args);
     va_end(args);
-    ebsp_send_string(buf);
 
     // Abort all cores and notify host
     _write_syncstate(STATE_ABORT);
     // Experimental Epiphany feature that sends
     // and abort signal to all cores
-    __asm__("MBKPT");
+    _halt_all_cores();
     // Halt this core
-    __asm__("trap 3");
+    _halt_core();
 }
 
 void EXT_MEM_TEXT ebsp_message(const char* format, ...) {
-    // Write the message to a buffer
-    char buf[128];
+    e_mutex_lock(0, 0, &coredata.ebsp_message_mutex);
     va_list args;
     va_start(args, format);
-    vsnprintf(&buf[0], sizeof(buf), format, args);
+    _log_print(format, args);
     va_end(args);
-
-    ebsp_send_string(buf);
+    e_mutex_unlock(0, 0, &coredata.ebsp_message_mutex);
 }
-
@@ -43,12 +43,44 @@ const char err_create_opened[] EXT_MEM_RO =
 const char err_out_of_memory[] EXT_MEM_RO =
     "BSP ERROR: could not allocate enough memory for stream";
 
+const char err_move_window[] EXT_MEM_RO =
+    "BSP ERROR: can not move the cursor of a stream that is refilled";
+
+const char err_reopen_window[] EXT_MEM_RO =
+    "BSP ERROR: can not open a stream that is refilled again";
+
+const char err_reopen_up_window[] EXT_MEM_RO =
+    "BSP ERROR: can not open a stream that is emptied again";
+
+// An up stream with a window is emptied by the host while it is written,
+// see ebsp_create_up_stream_to_fd. Its chunks are in `window` slots of fixed
+// size, with the chunk size in the header of the slot. The header is
+// CHUNK_PENDING while the slot holds no chunk, and the core only writes the
+// size after the DMA of the data has finished.
+
+// Publishes the chunk in `buffer` that was sent to the slot before the cursor
+static void _up_window_publish(ebsp_stream_descriptor* stream, void* buffer) {
+    int slot_size = stream->max_chunksize + 2 * sizeof(int);
+    ((int*)(stream->cursor - slot_size))[0] = ((int*)buffer)[0];
+}
+
+// Returns the data of the slot at the cursor, after waiting for the host
+static void* _up_window_slot(ebsp_stream_descriptor* stream) {
+    int slot_size = stream->max_chunksize + 2 * sizeof(int);
+    if (stream->cursor == stream->extmem_addr + stream->window * slot_size)
+        stream->cursor = stream->extmem_addr;
+    volatile int* header = (volatile int*)stream->cursor;
+    while (header[0] != CHUNK_PENDING)
+        _spin_wait();
+    return stream->cursor + 2 * sizeof(int);
+}
+
 void ebsp_set_up_chunk_size(unsigned stream_id, int nbytes) {
     ebsp_stream_descriptor* out_stream = &coredata.local_streams[stream_id];
 
     int* header = (int*)out_stream->current_buffer;
-    // update the *next* value to the new numer of bytes
-    header[1] = nbytes;
+    // update the size of the chunk, the header is a single int
+    header[0] = nbytes;
 }
 
 int ebsp_open_up_stream(void** address, unsigned stream_id) {
@@ -68,6 +100,11 @@ int ebsp_open_up_stream(void** address, unsigned stream_id) {
         ebsp_message(err_create_opened);
         return 0;
     }
+    // The host may have emptied the first slots of the window already
+    if (stream->window && stream->opened) {
+        ebsp_message(err_reopen_up_window);
+        return 0;
+    }
 
     stream->current_buffer = ebsp_malloc(stream->max_chunksize + sizeof(int));
     if (stream->current_buffer == NULL) {
@@ -75,13 +112,14 @@ int ebsp_open_up_stream(void** address, unsigned stream_id) {
         return 0;
     }
 
-    (*address) = (void*)((unsigned)stream->current_buffer + sizeof(int));
+    (*address) = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
 
     // Set the size to max_chunksize
     int* header = (int*)stream->current_buffer;
     header[0] = stream->max_chunksize;
 
     stream->cursor = stream->extmem_addr;
+    stream->opened = 1;
 
     return stream->max_chunksize;
 }
@@ -107,6 +145,8 @@ void ebsp_close_up_stream(unsigned stream_id) {
     // wait for data transfer to finish before closing
     ebsp_dma_handle* desc = (ebsp_dma_handle*)&out_stream->e_dma_desc;
     ebsp_dma_wait(desc);
+    if (out_stream->window && out_stream->next_buffer != NULL)
+        _up_window_publish(out_stream, out_stream->next_buffer);
 
     ebsp_free(out_stream->current_buffer);
     out_stream->current_buffer = NULL;
@@ -135,6 +175,8 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
     // if we prealloced last time, we have to wait until dma is finished
     if (stream->next_buffer != NULL) {
         ebsp_dma_wait(desc);
+        if (stream->window)
+            _up_window_publish(stream, stream->next_buffer);
     }
 
     if (prealloc) {
@@ -150,8 +192,8 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
         // read int header from current_buffer (next size)
         int chunk_size = ((int*)stream->current_buffer)[0];
 
-        void* src = (void*)((unsigned)stream->current_buffer + sizeof(int));
-        void* dst = stream->cursor;
+        void* src = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
+        void* dst = stream->window ? _up_window_slot(stream) : stream->cursor;
 
         ebsp_dma_push(desc, dst, src, chunk_size); // start dma
         // ebsp_dma_start();
@@ -160,7 +202,11 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
         stream->current_buffer = stream->next_buffer;
         stream->next_buffer = tmp;
 
-        stream->cursor += chunk_size; // move pointer in extmem
+        // move pointer in extmem, the slots of a window have a fixed size
+        if (stream->window)
+            stream->cursor += stream->max_chunksize + 2 * sizeof(int);
+        else
+            stream->cursor += chunk_size;
     } else // no prealloc
     {
         if (stream->next_buffer != NULL) {
@@ -171,17 +217,23 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
         // read int header from current_buffer (next size)
         int chunk_size = ((int*)stream->current_buffer)[0];
 
-        void* src = (void*)((unsigned)stream->current_buffer + sizeof(int));
-        void* dst = stream->cursor;
+        void* src = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
+        void* dst = stream->window ? _up_window_slot(stream) : stream->cursor;
 
         ebsp_dma_push(desc, dst, src, chunk_size); // start dma
         // ebsp_dma_start();
         ebsp_dma_wait(desc);
 
-        stream->cursor += chunk_size; // move pointer in extmem
+        // move pointer in extmem, the slots of a window have a fixed size
+        if (stream->window) {
+            stream->cursor += stream->max_chunksize + 2 * sizeof(int);
+            _up_window_publish(stream, stream->current_buffer);
+        } else {
+            stream->cursor += chunk_size;
+        }
     }
 
-    (*address) = (void*)((unsigned)stream->current_buffer + sizeof(int));
+    (*address) = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
 
     // Set the out_size to max_chunksize
     *((int*)(stream->current_buffer)) = stream->max_chunksize;
@@ -189,9 +241,32 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
     return stream->max_chunksize;
 }
 
+// A down stream with a window is refilled by the host while it is read,
+// see ebsp_create_down_stream_from_fd. Its chunks are in `window` slots of
+// fixed size, and every slot is marked as CHUNK_PENDING after the core read
+// it, so that the host can put a later chunk there.
+// Returns the size of the chunk at the cursor, after waiting for the host
+static int _window_chunk_size(ebsp_stream_descriptor* stream) {
+    int slot_size = stream->max_chunksize + 2 * sizeof(int);
+    void* base = stream->extmem_addr;
+
+    // The DMA of the previous chunk has finished when this is called
+    if (stream->cursor != base) {
+        ((int*)(stream->cursor - slot_size))[1] = CHUNK_PENDING;
+        if (stream->cursor == base + stream->window * slot_size)
+            stream->cursor = base;
+    }
+
+    volatile int* header = (volatile int*)stream->cursor;
+    while (header[1] == CHUNK_PENDING)
+        _spin_wait();
+    return header[1];
+}
+
 void _ebsp_write_chunk(ebsp_stream_descriptor* stream, void* target) {
     // read 2nd int in header from ext (next size)
-    int chunk_size = *(int*)(stream->cursor + sizeof(int));
+    int chunk_size = stream->window ? _window_chunk_size(stream)
+                                    : *(int*)(stream->cursor + sizeof(int));
     ebsp_dma_handle* desc = (ebsp_dma_handle*)&(stream->e_dma_desc);
 
     if (chunk_size != 0) // stream has not ended
@@ -203,8 +278,10 @@ void _ebsp_write_chunk(ebsp_stream_descriptor* stream, void* target) {
         ebsp_dma_push(desc, dst, src, chunk_size + 2 * sizeof(int));
         // ebsp_dma_start();
 
-        // jump over header+chunk
-        stream->cursor = (void*)(((unsigned)(stream->cursor)) +
+        // jump over header+chunk, the slots of a window have a fixed size
+        if (stream->window)
+            chunk_size = stream->max_chunksize;
+        stream->cursor = (void*)(((uintptr_t)(stream->cursor)) +
                                  2 * sizeof(int) + chunk_size);
     } else {
         // set next size to 0
@@ -228,6 +305,11 @@ int ebsp_open_down_stream(void** address, unsigned stream_id) {
         ebsp_message(err_open_opened);
         return 0;
     }
+    // The host has refilled the first slots of the window already
+    if (stream->window && stream->opened) {
+        ebsp_message(err_reopen_window);
+        return 0;
+    }
 
     stream->cursor = stream->extmem_addr;
 
@@ -240,8 +322,9 @@ int ebsp_open_down_stream(void** address, unsigned stream_id) {
     }
 
     _ebsp_write_chunk(stream, stream->next_buffer);
+    stream->opened = 1;
 
-    *address = (void*)((unsigned)stream->next_buffer + 2 * sizeof(int));
+    *address = (void*)((uintptr_t)stream->next_buffer + 2 * sizeof(int));
 
     return stream->max_chunksize;
 }
@@ -316,11 +399,11 @@ int ebsp_move_chunk_down(void** address, unsigned stream_id, int prealloc) {
     // Here: current_buffer contains data from THIS chunk
 
     // *address must point after the counter header
-    (*address) = (void*)((unsigned)stream->current_buffer + 2 * sizeof(int));
+    (*address) = (void*)((uintptr_t)stream->current_buffer + 2 * sizeof(int));
 
     // the counter header
     int current_chunk_size =
-        *((int*)((unsigned)stream->current_buffer + sizeof(int)));
+        *((int*)((uintptr_t)stream->current_buffer + sizeof(int)));
 
     if (current_chunk_size == 0) // stream has ended
     {
@@ -361,13 +444,18 @@ void ebsp_reset_down_cursor(int stream_id) {
 
     ebsp_stream_descriptor* in_stream = &coredata.local_streams[stream_id];
 
+    if (in_stream->window) {
+        ebsp_message(err_move_window);
+        return;
+    }
+
     size_t chunk_size = -1;
 
     // break when previous block has size 0 (begin of stream)
     while (chunk_size != 0) {
         // read 1st int in (prev size) header from ext
         chunk_size = *(int*)(in_stream->cursor);
-        in_stream->cursor = (void*)(((unsigned)(in_stream->cursor)) -
+        in_stream->cursor = (void*)(((uintptr_t)(in_stream->cursor)) -
                                     2 * sizeof(int) - chunk_size);
     }
 }
@@ -380,6 +468,11 @@ void ebsp_move_down_cursor(int stream_id, int jump_n_chunks) {
 
     ebsp_stream_descriptor* in_stream = &coredata.local_streams[stream_id];
 
+    if (in_stream->window) {
+        ebsp_message(err_move_window);
+        return;
+    }
+
     if (jump_n_chunks > 0) // jump forward
     {
         while (jump_n_chunks--) {
@@ -389,7 +482,7 @@ void ebsp_move_down_cursor(int stream_id, int jump_n_chunks) {
                 ebsp_message(err_jump_out_of_bounds);
                 return;
             }
-            in_stream->cursor = (void*)(((unsigned)(in_stream->cursor)) +
+            in_stream->cursor = (void*)(((uintptr_t)(in_stream->cursor)) +
                                         2 * sizeof(int) + chunk_size);
         }
     } else // jump backward
@@ -401,7 +494,7 @@ void ebsp_move_down_cursor(int stream_id, int jump_n_chunks) {
                 ebsp_message(err_jump_out_of_bounds);
                 return;
             }
-            in_stream->cursor = (void*)(((unsigned)(in_stream->cursor)) -
+            in_stream->cursor = (void*)(((uintptr_t)(in_stream->cursor)) -
                                         2 * sizeof(int) - chunk_size);
         }
     }
@@ -29,12 +29,12 @@ void _prepare_descriptor(e_dma_desc_t* desc, void* dst, const void* src,
                          size_t nbytes) {
     // Alignment
     unsigned index =
-        (((unsigned)dst) | ((unsigned)src) | ((unsigned)nbytes)) & 7;
+        (((uintptr_t)dst) | ((uintptr_t)src) | ((unsigned)nbytes)) & 7;
     unsigned shift = dma_data_size[index] >> 5;
 
     desc->config =
         E_DMA_MASTER | E_DMA_ENABLE | E_DMA_IRQEN | dma_data_size[index];
-    if ((((unsigned)dst) & local_mask) == 0)
+    if ((((uintptr_t)dst) & local_mask) == 0)
         desc->config |= E_DMA_MSGMODE;
     desc->inner_stride = 0x00010001 << shift;
     desc->count = 0x00010000 | (nbytes >> shift);
@@ -53,6 +53,11 @@ void ebsp_dma_push(ebsp_dma_handle* descriptor, void* dst, const void* src,
     // Set the contents of the descriptor
     _prepare_descriptor(desc, dst, src, nbytes);
 
+#ifdef EBSP_EMULATOR
+    e_emu_dma_push(desc);
+    return;
+#endif
+
     // Take the end of the current descriptor chain
     e_dma_desc_t* last = coredata.last_dma_desc;
 
@@ -62,7 +67,7 @@ void ebsp_dma_push(ebsp_dma_handle* descriptor, void* dst, const void* src,
     } else if (last != desc) {
         // Attach desc to last
         unsigned newconfig =
-            (last->config & 0x0000ffff) | ((unsigned)desc << 16);
+            (last->config & 0x0000ffff) | ((uintptr_t)desc << 16);
         last->config = newconfig;
         coredata.last_dma_desc = desc;
     }
@@ -71,12 +76,12 @@ void ebsp_dma_push(ebsp_dma_handle* descriptor, void* dst, const void* src,
     if (coredata.cur_dma_desc == 0) {
         // Start the DMA engine using the kickstart bit
         coredata.cur_dma_desc = desc;
-        unsigned kickstart = ((unsigned)desc << 16) | E_DMA_STARTUP;
+        unsigned kickstart = ((uintptr_t)desc << 16) | E_DMA_STARTUP;
         *coredata.dma1config = kickstart;
     }
 }
 
-void __attribute__((interrupt)) _dma_interrupt(int unusedargument) {
+void EBSP_INTERRUPT _dma_interrupt(int unusedargument) {
     // If DMA is in chaining mode, an interrupt will be fired after a chain
     // element is completed. At this point in the interrupt, the DMA will
     // already be busy doing the next element of the chain or even the one
@@ -97,7 +102,7 @@ void __attribute__((interrupt)) _dma_interrupt(int unusedargument) {
     // Grab the current task
     e_dma_desc_t* desc = coredata.cur_dma_desc;
     if (desc == 0) { // should not happen
-        combuf->interrupts[coredata.pid] =
+        coredata.tables.interrupts[coredata.pid] =
             0x80; // Use (1 << E_DMA1_INT) as error message
         return;
     }
@@ -106,19 +111,26 @@ void __attribute__((interrupt)) _dma_interrupt(int unusedargument) {
     desc->config &= ~(E_DMA_ENABLE);
 
     // Go to the 'next' task
-    e_dma_desc_t* next = (e_dma_desc_t*)(desc->config >> 16);
+    e_dma_desc_t* next = (e_dma_desc_t*)(uintptr_t)(desc->config >> 16);
     coredata.cur_dma_desc = next;
 
     if (next) {
         // Start the DMA engine using the kickstart bit
-        unsigned kickstart = ((unsigned)next << 16) | E_DMA_STARTUP;
+        unsigned kickstart = ((uintptr_t)next << 16) | E_DMA_STARTUP;
         *coredata.dma1config = kickstart;
+    } else {
+        // The chain is finished, so the next push starts a new one
+        // instead of attaching to a descriptor that may be reused
+        coredata.last_dma_desc = NULL;
     }
 }
 
 void ebsp_dma_wait(ebsp_dma_handle* descriptor) {
+#ifdef EBSP_EMULATOR
+    e_emu_dma_wait((e_dma_desc_t*)descriptor);
+#endif
     volatile unsigned* config = &descriptor->config;
-    while (*config & E_DMA_ENABLE) {
-    }
+    while (*config & E_DMA_ENABLE)
+        _spin_wait();
 }
 
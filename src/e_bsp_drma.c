@@ -44,24 +44,94 @@ const char err_put_overflow[] EXT_MEM_RO =
 const char err_put_overflow2[] EXT_MEM_RO =
     "BSP ERROR: too large bsp_put payload per sync";
 
+const char err_put_staging[] EXT_MEM_RO =
+    "BSP ERROR: ebsp_set_put_staging called after bsp_put in the same sync";
+
+const char err_var_table_memory[] EXT_MEM_RO =
+    "BSP ERROR: could not allocate the table of bsp vars";
+
+// Position of `addr` in the hash table of registered variables
+// Only shifts and xor, because the Epiphany-III has no integer multiply
+static inline unsigned _var_hash(const void* addr) {
+    uintptr_t a = (uintptr_t)addr;
+    return ((a >> 3) ^ (a >> 10)) & (VAR_TABLE_SIZE - 1);
+}
+
+void EXT_MEM_TEXT _init_var_table() {
+    coredata.var_table_addr = ebsp_malloc(VAR_TABLE_SIZE * sizeof(void*));
+    coredata.var_table_slot = ebsp_malloc(VAR_TABLE_SIZE * sizeof(int8_t));
+    if (coredata.var_table_addr == 0 || coredata.var_table_slot == 0) {
+        // bsp_push_reg reports the error
+        if (coredata.var_table_addr != 0)
+            ebsp_free(coredata.var_table_addr);
+        if (coredata.var_table_slot != 0)
+            ebsp_free(coredata.var_table_slot);
+        coredata.var_table_addr = 0;
+        coredata.var_table_slot = 0;
+        return;
+    }
+    for (int i = 0; i < VAR_TABLE_SIZE; i++)
+        coredata.var_table_addr[i] = 0;
+
+    // Without local memory for it, the remote addresses are read from
+    // bsp_var_list in external memory
+    coredata.var_remote = 0;
+    if (coredata.tables.ncores <= VAR_REMOTE_MAX_CORES) {
+        coredata.var_remote = ebsp_malloc(MAX_BSP_VARS * sizeof(uintptr_t*));
+        if (coredata.var_remote != 0)
+            for (int i = 0; i < MAX_BSP_VARS; i++)
+                coredata.var_remote[i] = 0;
+    }
+}
+
+// Copies the remote addresses of `slot` of bsp_var_list to local memory,
+// after all cores registered their variable in bsp_sync. A negative slot
+// means that the hash table did not get a new entry
+void EXT_MEM_TEXT _cache_remote_addrs(int slot) {
+    if (coredata.var_remote == 0 || slot < 0)
+        return;
+    uintptr_t* remote = ebsp_malloc(coredata.nprocs * sizeof(uintptr_t));
+    if (remote == 0)
+        return;
+    void** list = &coredata.tables.bsp_var_list[slot * coredata.tables.ncores];
+    for (int pid = 0; pid < coredata.nprocs; pid++) {
+        uintptr_t uptr = (uintptr_t)list[pid];
+        if ((uptr & 0xfff00000) == 0) // local
+            uptr |= ((uintptr_t)coredata.coreids[pid]) << 20;
+        remote[pid] = uptr;
+    }
+    coredata.var_remote[slot] = remote;
+}
+
 // This incoroporates the bsp_var_list as well as
 // the epiphany global address system
 // The resulting address can be written to directly
 void* _get_remote_addr(int pid, const void* addr, int offset) {
-    // Find the slot for our local pid
+    // Find the slot of the variable in the local table
     // And return the entry for the remote pid including the epiphany mapping
-    for (int slot = 0; slot < MAX_BSP_VARS; ++slot) {
-        if (combuf->bsp_var_list[slot][coredata.pid] == addr) {
+    unsigned i = _var_hash(addr);
+    const void* entry;
+    while (coredata.var_table_addr != 0 &&
+           (entry = coredata.var_table_addr[i]) != 0) {
+        if (entry == addr) {
+            int slot = coredata.var_table_slot[i];
+            if (coredata.var_remote != 0 && coredata.var_remote[slot] != 0)
+                return (void*)(coredata.var_remote[slot][pid] + offset);
+
             // Address as registered by other core and as seen by other core
-            unsigned uptr = (unsigned)combuf->bsp_var_list[slot][pid] + offset;
+            uintptr_t uptr =
+                (uintptr_t)coredata.tables
+                    .bsp_var_list[slot * coredata.tables.ncores + pid] +
+                offset;
 
             // If it was global, then it is directly valid from here
             // If it was local, add the remote coreid in the highest 12 bits
             if ((uptr & 0xfff00000) == 0) // local
-                uptr |= ((uint32_t)coredata.coreids[pid]) << 20;
+                uptr |= ((uintptr_t)coredata.coreids[pid]) << 20;
 
             return (void*)uptr;
         }
+        i = (i + 1) & (VAR_TABLE_SIZE - 1);
     }
     ebsp_message(err_var_not_found, addr);
     return 0;
@@ -71,11 +141,28 @@ void EXT_MEM_TEXT bsp_push_reg(const void* variable, const int nbytes) {
     if (coredata.var_pushed)
         return ebsp_message(err_pushreg_multiple);
 
-    if (combuf->bsp_var_counter == MAX_BSP_VARS)
+    if (coredata.var_table_addr == 0)
+        return ebsp_message(err_var_table_memory);
+
+    int slot = combuf->bsp_var_counter;
+    if (slot == MAX_BSP_VARS)
         return ebsp_message(err_pushreg_overflow);
 
-    combuf->bsp_var_list[combuf->bsp_var_counter][coredata.pid] =
-        (void*)variable;
+    coredata.tables.bsp_var_list[slot * coredata.tables.ncores +
+                                 coredata.pid] = (void*)variable;
+
+    // A variable that is registered again keeps its first slot, so only
+    // the remote addresses of a new entry are copied to local memory
+    coredata.var_pushed_slot = -1;
+    unsigned i = _var_hash(variable);
+    while (coredata.var_table_addr[i] != 0 &&
+           coredata.var_table_addr[i] != variable)
+        i = (i + 1) & (VAR_TABLE_SIZE - 1);
+    if (variable != 0 && coredata.var_table_addr[i] == 0) {
+        coredata.var_table_addr[i] = variable;
+        coredata.var_table_slot[i] = slot;
+        coredata.var_pushed_slot = slot;
+    }
 
     coredata.var_pushed = 1;
 }
@@ -85,55 +172,147 @@ void EXT_MEM_TEXT bsp_pop_reg(const void* variable) {
     return;
 }
 
+// The last request of this sync if it is of the same kind (`put` is 0 or
+// DATA_PUT_BIT) and its destination ends at `dst`, so that a new request
+// starting at `dst` can be merged with it. Otherwise 0
+static ebsp_data_request* EXT_MEM_TEXT _continued_request(int put,
+                                                           const void* dst) {
+    uint32_t req_count = coredata.request_counter;
+    if (req_count == 0)
+        return 0;
+    ebsp_data_request* req =
+        &coredata.tables
+             .data_requests[coredata.pid * MAX_DATA_REQUESTS + req_count - 1];
+    int nbytes = req->nbytes;
+    if ((nbytes & DATA_PUT_BIT) != put ||
+        (char*)req->dst + (nbytes & ~DATA_PUT_BIT) != dst)
+        return 0;
+    return req;
+}
+
+// Returns 1 when `payload_ptr` is right after the payload of `prev`,
+// so that a put with that payload can be merged with `prev`
+static int EXT_MEM_TEXT _continues_payload(ebsp_data_request* prev,
+                                           const void* payload_ptr) {
+    return prev != 0 &&
+           (char*)prev->src + (prev->nbytes & ~DATA_PUT_BIT) == payload_ptr;
+}
+
+// Saves the request of a bsp_put and copies the payload to `payload_ptr`
+// The request is merged with `prev` when it is not 0, otherwise the caller
+// has checked that the request table has room for it
+static void EXT_MEM_TEXT _store_put_request(ebsp_data_request* prev,
+                                            void* payload_ptr,
+                                            void* dst_remote, const void* src,
+                                            int nbytes) {
+    if (prev) {
+        prev->nbytes += nbytes;
+    } else {
+        uint32_t req_count = coredata.request_counter;
+        ebsp_data_request* req =
+            &coredata.tables
+                 .data_requests[coredata.pid * MAX_DATA_REQUESTS + req_count];
+        req->src = payload_ptr;
+        req->dst = dst_remote;
+        req->nbytes = nbytes | DATA_PUT_BIT;
+        coredata.request_counter = req_count + 1;
+    }
+
+    // Save payload
+    ebsp_memcpy(payload_ptr, src, nbytes);
+}
+
 void EXT_MEM_TEXT
 bsp_put(int pid, const void* src, void* dst, int offset, int nbytes) {
-    // Check if we can store the request
-    if (coredata.request_counter >= MAX_DATA_REQUESTS)
-        return ebsp_message(err_put_overflow);
-
     // Find remote address
     void* dst_remote = _get_remote_addr(pid, dst, offset);
     if (!dst_remote)
         return;
 
-    // Check if we can store the payload
+    // A put that continues the destination of the previous put is merged
+    // with it when its payload is stored right after the previous one.
+    // Otherwise it needs a new request, and the request table is checked
+    // before any space for the payload is taken
+    ebsp_data_request* prev = _continued_request(DATA_PUT_BIT, dst_remote);
+    int table_full = coredata.request_counter >= MAX_DATA_REQUESTS;
+
+    // Payloads that fit in the staging buffer in local memory are stored
+    // there, which saves a write and a read of external memory
+    void* payload_ptr;
+    uint32_t staging_offset = coredata.put_staging_used;
+    if (prev) {
+        // Skip the alignment padding if the previous payload is the last
+        // one in the staging buffer
+        uintptr_t prev_end = (uintptr_t)prev->src +
+                             (prev->nbytes & ~DATA_PUT_BIT) -
+                             (uintptr_t)coredata.put_staging;
+        if (prev_end <= staging_offset)
+            staging_offset = prev_end;
+    }
+    if (staging_offset + nbytes <= coredata.put_staging_size) {
+        payload_ptr = coredata.put_staging + staging_offset;
+        if (!_continues_payload(prev, payload_ptr)) {
+            if (table_full)
+                return ebsp_message(err_put_overflow);
+            prev = 0;
+        }
+        // Keep the next payload 8-byte aligned for ebsp_memcpy
+        coredata.put_staging_used = EBSP_ALIGN(staging_offset + nbytes, 8);
+        _store_put_request(prev, payload_ptr, dst_remote, src, nbytes);
+        return;
+    }
+
+    // Otherwise store it in external memory
     // A mutex is needed for this.
     // While holding the mutex this core checks if it can store
     // the payload and if so, updates the buffer
     // Note that the mutex is NOT held while writing the payload itself
     // A possible error message is given after unlocking
+    // The payload continues the previous one if no other core stored a
+    // payload in between, which is only known while holding the mutex
     unsigned int payload_offset;
+    const char* error = 0;
 
     e_mutex_lock(0, 0, &coredata.payload_mutex);
 
     payload_offset = combuf->data_payloads.buffer_size;
+    payload_ptr = &combuf->data_payloads.buf[payload_offset];
 
     if (payload_offset + nbytes > MAX_PAYLOAD_SIZE)
-        payload_offset = -1;
+        error = err_put_overflow2;
+    else if (!_continues_payload(prev, payload_ptr) && table_full)
+        error = err_put_overflow;
     else
         combuf->data_payloads.buffer_size += nbytes;
 
     e_mutex_unlock(0, 0, &coredata.payload_mutex);
 
-    if (payload_offset == -1)
-        return ebsp_message(err_put_overflow2);
-
-    // We are now ready to save the request and payload
-    void* payload_ptr = &combuf->data_payloads.buf[payload_offset];
+    if (error)
+        return ebsp_message(error);
+    if (!_continues_payload(prev, payload_ptr))
+        prev = 0;
 
     // TODO(Tom)
     // Measure if e_dma_copy is faster here for both request and payload
+    _store_put_request(prev, payload_ptr, dst_remote, src, nbytes);
+}
 
-    // Save request
-    uint32_t req_count = coredata.request_counter;
-    ebsp_data_request* req = &combuf->data_requests[coredata.pid][req_count];
-    req->src = payload_ptr;
-    req->dst = dst_remote;
-    req->nbytes = nbytes | DATA_PUT_BIT;
-    coredata.request_counter = req_count + 1;
-
-    // Save payload
-    ebsp_memcpy(payload_ptr, src, nbytes);
+int EXT_MEM_TEXT ebsp_set_put_staging(unsigned int nbytes) {
+    if (coredata.put_staging_used != 0) {
+        ebsp_message(err_put_staging);
+        return 0;
+    }
+    if (coredata.put_staging)
+        ebsp_free(coredata.put_staging);
+    coredata.put_staging = 0;
+    coredata.put_staging_size = 0;
+    if (nbytes == 0)
+        return 1;
+    coredata.put_staging = ebsp_malloc(nbytes);
+    if (coredata.put_staging == 0)
+        return 0;
+    coredata.put_staging_size = nbytes;
+    return 1;
 }
 
 void bsp_hpput(int pid, const void* src, void* dst, int offset, int nbytes) {
@@ -145,14 +324,25 @@ void bsp_hpput(int pid, const void* src, void* dst, int offset, int nbytes) {
 
 void EXT_MEM_TEXT
 bsp_get(int pid, const void* src, int offset, void* dst, int nbytes) {
-    if (coredata.request_counter >= MAX_DATA_REQUESTS)
-        return ebsp_message(err_get_overflow);
     const void* src_remote = _get_remote_addr(pid, src, offset);
     if (!src_remote)
         return;
 
+    // A get that continues both the source and the destination of the
+    // previous get is merged with it
+    ebsp_data_request* prev = _continued_request(0, dst);
+    if (prev && (const char*)prev->src + prev->nbytes == src_remote) {
+        prev->nbytes += nbytes;
+        return;
+    }
+
+    if (coredata.request_counter >= MAX_DATA_REQUESTS)
+        return ebsp_message(err_get_overflow);
+
     uint32_t req_count = coredata.request_counter;
-    ebsp_data_request* req = &combuf->data_requests[coredata.pid][req_count];
+    ebsp_data_request* req =
+        &coredata.tables
+             .data_requests[coredata.pid * MAX_DATA_REQUESTS + req_count];
     req->src = src_remote;
     req->dst = dst;
     req->nbytes = nbytes;
@@ -169,3 +359,13 @@ void bsp_hpget(int pid, const void* src, int offset, void* dst, int nbytes) {
 void* ebsp_get_direct_address(int pid, const void* variable) {
     return _get_remote_addr(pid, variable, 0);
 }
+
+void* ebsp_sym_address(int pid, const void* ptr) {
+#ifdef EBSP_EMULATOR
+    // Every emulated core has its own block of local memory
+    int cols = e_group_config.group_cols;
+    return e_get_global_address(pid / cols, pid % cols, ptr);
+#else
+    return (void*)(((uintptr_t)coredata.coreids[pid] << 20) | (uintptr_t)ptr);
+#endif
+}
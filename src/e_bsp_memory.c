@@ -30,21 +30,36 @@ const char err_allocation[] EXT_MEM_RO =
     "BSP ERROR: allocation of %d bytes of local memory overwrites the stack";
 
 
+#ifdef EBSP_EMULATOR
+// The emulator provides a separate block of local memory for malloc
+#define LOCAL_HEAP_START ((uintptr_t)e_emu_local_memory())
+#define LOCAL_HEAP_END (LOCAL_HEAP_START + e_emu_local_memory_size())
+#else
 // This variable indicates end of global vars
 // So 'end' until 'stack' can be used by malloc
 extern int end;
+#define LOCAL_HEAP_START ((uintptr_t)(&end + 8))
+#define LOCAL_HEAP_END 0x8000
+#endif
+
+// The local heap is smaller than the local memory, so its bitmasks fit
+// in a buffer of this many ints, see ebsp_sym_malloc
+#define MAX_LOCAL_BITMASK_INTS compute_total_bitmask_ints(LOCAL_MEMORY_END)
+
+// Set by every core in ebsp_sym_malloc, to agree on failure
+static volatile int8_t sym_malloc_ok;
 
 // Called in bsp_begin by every core
 void EXT_MEM_TEXT _init_local_malloc() {
-    coredata.local_malloc_base = (void*)chunk_roundup((uint32_t)(&end + 8));
-    uint32_t size = 0x8000 - (uint32_t)coredata.local_malloc_base;
+    coredata.local_malloc_base = (void*)chunk_roundup(LOCAL_HEAP_START);
+    uint32_t size = LOCAL_HEAP_END - (uintptr_t)coredata.local_malloc_base;
     _init_malloc_state(coredata.local_malloc_base, size);
 }
 
 void* EXT_MEM_TEXT ebsp_ext_malloc(unsigned int nbytes) {
     void* ret = 0;
     e_mutex_lock(0, 0, &coredata.malloc_mutex);
-    ret = _malloc((void*)E_DYNMEM_ADDR, nbytes);
+    ret = _malloc(coredata.dynmem, nbytes);
     e_mutex_unlock(0, 0, &coredata.malloc_mutex);
     return ret;
 }
@@ -59,6 +74,7 @@ void* EXT_MEM_TEXT ebsp_malloc(unsigned int nbytes) {
     if (ret == 0)
         return 0;
 
+#ifndef EBSP_EMULATOR
     // Check if it does not overwrite the current stack position
     // Plus 128 bytes of margin
     if ((uint32_t)ret + nbytes + 128 > (uint32_t)&ret) // <-- only epiphany
@@ -67,13 +83,64 @@ void* EXT_MEM_TEXT ebsp_malloc(unsigned int nbytes) {
         ebsp_message(err_allocation, nbytes);
         return 0;
     }
+#endif
     return ret;
 }
 
+void* EXT_MEM_TEXT ebsp_sym_malloc(unsigned int nbytes) {
+    void* base = coredata.local_malloc_base;
+    uint32_t total_bitmask_ints = get_bitmask_count(base);
+    uint32_t chunk_count = chunk_division(nbytes + sizeof(memory_object));
+
+    // The heap starts at the same address on every core, so a chunk that
+    // is free on every core gives the same address everywhere.
+    // The bitmasks are read after all cores have finished their previous
+    // allocations, and changed after all cores have read them.
+    uint32_t used[MAX_LOCAL_BITMASK_INTS];
+    for (uint32_t i = 0; i < total_bitmask_ints; ++i)
+        used[i] = 0;
+    ebsp_barrier();
+    for (int s = 0; s < coredata.nprocs; ++s) {
+        const uint32_t* bitmasks = ebsp_sym_address(s, get_bitmasks(base));
+        for (uint32_t i = 0; i < total_bitmask_ints; ++i)
+            used[i] |= bitmasks[i];
+    }
+    ebsp_barrier();
+
+    uint32_t chunk = _find_chunks(used, total_bitmask_ints, chunk_count);
+    int8_t ok = (chunk != NO_CHUNKS);
+
+#ifndef EBSP_EMULATOR
+    // Check if it does not overwrite the current stack position
+    // Plus 128 bytes of margin
+    if (ok) {
+        uint32_t end = (uint32_t)get_alloc_base(base) + CHUNK_SIZE * chunk +
+                       sizeof(memory_object) + nbytes;
+        if (end + 128 > (uint32_t)&end) {
+            ebsp_message(err_allocation, nbytes);
+            ok = 0;
+        }
+    }
+#endif
+
+    // The stack differs per core, so every core allocates or none does.
+    // A next call only writes sym_malloc_ok after its first barrier, when
+    // all cores have read it.
+    sym_malloc_ok = ok;
+    ebsp_barrier();
+    for (int s = 0; s < coredata.nprocs; ++s)
+        if (!*(volatile int8_t*)ebsp_sym_address(s, (void*)&sym_malloc_ok))
+            ok = 0;
+    if (!ok)
+        return 0;
+    return _use_chunks(base, chunk, chunk_count);
+}
+
 void EXT_MEM_TEXT ebsp_free(void* ptr) {
-    if (((unsigned)ptr) & 0xfff00000) {
+    if ((uintptr_t)ptr >= (uintptr_t)coredata.dynmem &&
+        (uintptr_t)ptr < E_EXTMEM_ADDR + EXTMEM_SIZE) {
         e_mutex_lock(0, 0, &coredata.malloc_mutex);
-        _free((void*)E_DYNMEM_ADDR, ptr);
+        _free(coredata.dynmem, ptr);
         e_mutex_unlock(0, 0, &coredata.malloc_mutex);
     } else {
         _free(coredata.local_malloc_base, ptr);
@@ -81,7 +148,7 @@ void EXT_MEM_TEXT ebsp_free(void* ptr) {
 }
 
 void ebsp_memcpy(void* dest, const void* source, size_t nbytes) {
-    unsigned bits = (unsigned)dest | (unsigned)source;
+    unsigned bits = (uintptr_t)dest | (uintptr_t)source;
     if ((bits & 0x7) == 0) {
         // 8-byte aligned
         long long* dst = (long long*)dest;
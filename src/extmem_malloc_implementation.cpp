@@ -61,7 +61,7 @@ typedef struct {
 // The allocated memory starts at
 // chunk_roundup(base + 4 + total_bitmask_ints*4)
 // Round up to the next multiple of CHUNK_SIZE only if not a multiple yet
-inline uint32_t chunk_roundup(uint32_t a) {
+inline uintptr_t chunk_roundup(uintptr_t a) {
     // Compiler optimizes this function to (((a+7)>>3)<<3)
     // I also tested ((a+7) & ~7)
     // but this is 4 extra bytes of assembly and
@@ -84,17 +84,17 @@ inline uint32_t* get_bitmasks(const void* base) {
 }
 
 inline void* get_alloc_base(const void* base) {
-    return (void*)chunk_roundup((uint32_t)(base + 4 * (1 + *(uint32_t*)base)));
+    return (void*)chunk_roundup((uintptr_t)(base + 4 * (1 + *(uint32_t*)base)));
 }
 
-// ebsp_ext_malloc wraps this in a mutex
-void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
-    nbytes += sizeof(memory_object);
-    uint32_t chunk_count = chunk_division(nbytes);
-
-    uint32_t total_bitmask_ints = get_bitmask_count(base);
-    uint32_t* bitmasks = get_bitmasks(base);
+// Returned by _find_chunks when there is no free sequence of chunks
+#define NO_CHUNKS 0xffffffff
 
+// Search `bitmasks` for a sequence of chunk_count free chunks
+// Returns the index of the first chunk, or NO_CHUNKS
+uint32_t MALLOC_FUNCTION_PREFIX _find_chunks(const uint32_t* bitmasks,
+                                             uint32_t total_bitmask_ints,
+                                             uint32_t chunk_count) {
     // Search for a sequence of chunk_count zero bits
     uint32_t start_mask = 0;
     uint32_t start_bit = 0;
@@ -132,16 +132,26 @@ void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
                 }
                 mask >>= 1;
             }
+            if (chunks_left == 0)
+                break;
         }
     }
     // Unable to find free space
     if (chunks_left != 0)
-        return 0;
+        return NO_CHUNKS;
+    return start_mask * 32 + start_bit;
+}
+
+// Marks chunk_count chunks starting at `chunk` as used
+// and returns the allocated memory
+void* MALLOC_FUNCTION_PREFIX _use_chunks(void* base, uint32_t chunk,
+                                         uint32_t chunk_count) {
+    uint32_t* bitmasks = get_bitmasks(base);
 
-    // Fill all the bits that we found starting at start_mask,start_bit
-    chunks_left = chunk_count;
-    uint32_t bit = (1U << start_bit);
-    for (uint32_t i = start_mask; chunks_left != 0; i++) {
+    // Fill all the bits starting at chunk
+    uint32_t chunks_left = chunk_count;
+    uint32_t bit = (1U << (chunk % 32));
+    for (uint32_t i = chunk / 32; chunks_left != 0; i++) {
         uint32_t mask = bitmasks[i];
         for (; bit != 0 && chunks_left != 0; bit <<= 1) {
             mask |= bit;
@@ -152,16 +162,27 @@ void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
     }
 
     // Bits have been filled. Now put a memory_object at the allocated space
-    void* ptr =
-        get_alloc_base(base) + CHUNK_SIZE * (start_mask * 32 + start_bit);
+    void* ptr = get_alloc_base(base) + CHUNK_SIZE * chunk;
     ((memory_object*)ptr)->chunk_count = chunk_count;
     return ptr + sizeof(memory_object);
 }
 
+// ebsp_ext_malloc wraps this in a mutex
+void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
+    nbytes += sizeof(memory_object);
+    uint32_t chunk_count = chunk_division(nbytes);
+
+    uint32_t chunk = _find_chunks(get_bitmasks(base), get_bitmask_count(base),
+                                  chunk_count);
+    if (chunk == NO_CHUNKS)
+        return 0;
+    return _use_chunks(base, chunk, chunk_count);
+}
+
 void MALLOC_FUNCTION_PREFIX _free(void* base, void* ptr) {
     ptr -= sizeof(memory_object);
     uint32_t chunk_start =
-        ((unsigned)(ptr - get_alloc_base(base))) / CHUNK_SIZE;
+        ((uint32_t)(ptr - get_alloc_base(base))) / CHUNK_SIZE;
     uint32_t chunk_count = ((memory_object*)ptr)->chunk_count;
 
     uint32_t* bitmasks = get_bitmasks(base);
@@ -180,6 +201,40 @@ void MALLOC_FUNCTION_PREFIX _free(void* base, void* ptr) {
     return;
 }
 
+// Returns the largest nbytes for which _malloc currently succeeds,
+// without allocating anything
+uint32_t MALLOC_FUNCTION_PREFIX _largest_free_block(const void* base) {
+    const uint32_t* bitmasks = get_bitmasks(base);
+    uint32_t total_bitmask_ints = get_bitmask_count(base);
+
+    // Longest sequence of free chunks
+    uint32_t longest = 0;
+    uint32_t current = 0;
+    for (uint32_t i = 0; i < total_bitmask_ints; ++i) {
+        uint32_t mask = bitmasks[i];
+        if (mask == 0) {
+            current += 32;
+            continue;
+        }
+        for (uint32_t j = 0; j < 32; ++j) {
+            if (mask & 1) {
+                if (current > longest)
+                    longest = current;
+                current = 0;
+            } else {
+                current++;
+            }
+            mask >>= 1;
+        }
+    }
+    if (current > longest)
+        longest = current;
+
+    if (longest * CHUNK_SIZE <= sizeof(memory_object))
+        return 0;
+    return longest * CHUNK_SIZE - sizeof(memory_object);
+}
+
 // Initializes the malloc table
 void MALLOC_FUNCTION_PREFIX _init_malloc_state(void* base, uint32_t size) {
     uint32_t total_bitmask_ints = compute_total_bitmask_ints(size);
@@ -23,16 +23,23 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include "host_bsp_private.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 #include <e-loader.h>
+#include <pthread.h>
 
 #define __USE_XOPEN2K
 #include <unistd.h> // For the function 'access' in bsp_init
 
 bsp_state_t state;
 
-int bsp_initialized = 0; // 1 after bsp_init, 2 after bsp_begin, 3 after ebsp_spmd, 0 after bsp_end
+// Fast start mode, see ebsp_set_fast_start
+// The cores are known to be idle when all of them finished the last program
+static int fast_start = 0;
+static int cores_idle = 0;
+
+int bsp_initialized = 0; // 1 after bsp_init, 2 after bsp_begin (or when preparing another run), 3 after ebsp_spmd, 0 after bsp_end
 
 int bsp_init(const char* _e_name, int argc, char** argv) {
     if (bsp_initialized) {
@@ -59,7 +66,8 @@ int bsp_init(const char* _e_name, int argc, char** argv) {
     }
 
     // Reset the Epiphany system
-    if (e_reset_system() != E_OK) {
+    // In fast start mode this is not needed when the cores are idle
+    if ((!fast_start || !cores_idle) && e_reset_system() != E_OK) {
         fprintf(stderr, "ERROR: Could not reset the Epiphany system.\n");
         return 0;
     }
@@ -78,6 +86,52 @@ int bsp_init(const char* _e_name, int argc, char** argv) {
     return 1;
 }
 
+// Down-messages are written directly to external memory,
+// so the queues are reset there
+static void _reset_message_queues() {
+    ebsp_combuf* combuf = (ebsp_combuf*)state.host_combuf_addr;
+    combuf->message_queue[0].count = 0;
+    combuf->message_queue[1].count = 0;
+    combuf->data_payloads.buffer_size = 0;
+    state.message_index = 0;
+}
+
+// Called by every function that prepares a run of the e-program.
+// When the previous run has finished, its messages, streams and external
+// memory allocations are released so that the loaded program can be
+// started again. Until then the results of that run can be read.
+// In batch mode this happens as soon as the previous run was started,
+// for the streams and external memory of the slot that it does not use.
+void _prepare_next_run() {
+    if (bsp_initialized != 3)
+        return;
+
+    ebsp_malloc_init();
+    for (int p = 0; p < state.tables.ncores; p++)
+        state.tables.n_streams[p] = 0;
+    // In batch mode the cores may still use the message queues
+    if (!state.batch_mode)
+        _prepare_next_messages();
+
+    bsp_initialized = 2;
+}
+
+// Called before messages are written to the queues for the next run
+void _prepare_next_messages() {
+    if (!state.queues_used)
+        return;
+    _reset_message_queues();
+    state.queues_used = 0;
+}
+
+// Chooses the first rows of the chip that hold `nprocs` cores. The rows
+// span the full width of the chip, so pid `s` is on the core at row
+// s / cols and column s % cols, as when the full chip is used.
+static void _choose_workgroup(int nprocs, int* rows, int* cols) {
+    *cols = state.platform.cols;
+    *rows = (nprocs + *cols - 1) / *cols;
+}
+
 int bsp_begin(int nprocs) {
     if (bsp_initialized != 1) {
         fprintf(stderr, "ERROR: bsp_begin called twice or called before bsp_init\n");
@@ -89,16 +143,14 @@ int bsp_begin(int nprocs) {
     // Then the functions that DID succeed should be undone again
     // So at e_load_group failure it cleanup the e_open result
 
-    if (nprocs < 1 || nprocs > NPROCS) {
+    if (nprocs < 1 || nprocs > MAX_NPROCS || nprocs > state.nprocs) {
         fprintf(stderr, "ERROR: bsp_begin called with nprocs = %d.\n", nprocs);
         return 0;
     }
 
-    // TODO(*) non-rectangle
-    // state.rows = (nprocs / state.platform.rows);
-    // state.cols = nprocs / (nprocs / state.platform.rows);
-    state.rows = state.platform.rows;
-    state.cols = state.platform.cols;
+    // Only the cores that are needed are part of the workgroup,
+    // the other cores of the chip are not reset, loaded or started
+    _choose_workgroup(nprocs, &state.rows, &state.cols);
 
 #ifdef DEBUG
     printf("(BSP) INFO: Making a workgroup of size %i x %i\n", state.rows,
@@ -114,7 +166,7 @@ int bsp_begin(int nprocs) {
         return 0;
     }
 
-    if (e_reset_group(&state.dev) != E_OK) {
+    if ((!fast_start || !cores_idle) && e_reset_group(&state.dev) != E_OK) {
         fprintf(stderr, "ERROR: Could not reset workgroup.\n");
         return 0;
     }
@@ -123,106 +175,185 @@ int bsp_begin(int nprocs) {
 #ifdef DEBUG
     printf("(BSP) INFO: Loading: %s\n", state.e_fullpath);
 #endif
-    if (e_load_group(state.e_fullpath, &state.dev, 0, 0, state.rows, state.cols,
-                     E_FALSE) != E_OK) {
+    int loaded;
+    if (fast_start)
+        loaded = _load_program(state.e_fullpath);
+    else
+        loaded = (e_load_group(state.e_fullpath, &state.dev, 0, 0, state.rows,
+                               state.cols, E_FALSE) == E_OK);
+    if (!loaded) {
         fprintf(stderr, "ERROR: Could not load program in workgroup.\n");
         return 0;
     }
 
     // e_alloc will mmap combuf and dynmem
     // The offset in external memory is equal to NEWLIB_SIZE
-    if (e_alloc(&state.emem, NEWLIB_SIZE, COMBUF_SIZE + DYNMEM_SIZE) != E_OK) {
+    if (e_alloc(&state.emem, NEWLIB_SIZE, EXTMEM_SIZE - NEWLIB_SIZE) != E_OK) {
+        fprintf(stderr, "ERROR: e_alloc failed in bspbegin.\n");
+        return 0;
+    }
+    if (e_alloc(&state.newlib, 0, NEWLIB_SIZE) != E_OK) {
         fprintf(stderr, "ERROR: e_alloc failed in bspbegin.\n");
+        e_free(&state.emem);
         return 0;
     }
+
+    // The local copy of the combuf has tables for the cores of the workgroup
+    // Set it to zero so that it can be filled before calling ebsp_spmd
+    int ncores = state.rows * state.cols;
+    state.combuf_size = ebsp_combuf_layout(&state.tables, NULL, ncores);
+    state.combuf = calloc(1, state.combuf_size);
+    state.stream_vectors = calloc(ncores, sizeof(ebsp_stream_vector));
+    if (state.combuf == NULL || state.stream_vectors == NULL) {
+        fprintf(stderr, "ERROR: Could not allocate the local combuf.\n");
+        return 0;
+    }
+    ebsp_combuf_layout(&state.tables, state.combuf, ncores);
+    state.combuf->tagsize = state.tagsize;
+    state.n_dirty_regions = 0;
+
     state.host_combuf_addr = state.emem.base;
-    state.host_dynmem_addr = state.emem.base + COMBUF_SIZE;
+    state.host_dynmem_addr = state.emem.base + state.combuf_size;
 
     ebsp_malloc_init();
-
-    // Set initial buffer to zero so that it can be filled by messages
-    // before calling ebsp_spmd
-    memset(&state.combuf, 0, sizeof(ebsp_combuf));
+    _reset_message_queues();
 
     bsp_initialized = 2;
 
     return 1;
 }
 
-int ebsp_spmd() {
-    if (bsp_initialized != 2) {
-        fprintf(stderr, "ERROR: ebsp_spmd called before bsp_begin\n");
+// Prepares the communication buffer and starts the cores
+static int _spmd_start(const char* caller) {
+    if (bsp_initialized != 2 && bsp_initialized != 3) {
+        fprintf(stderr, "ERROR: %s called before bsp_begin\n", caller);
+        return 0;
+    }
+    if (state.spmd_handle != 0) {
+        fprintf(stderr, "ERROR: %s called before the asynchronous run was "
+                        "finished with ebsp_spmd_wait\n",
+                caller);
         return 0;
     }
 
+    // Running again without preparing anything starts with empty queues
+    _prepare_next_run();
+    _prepare_next_messages();
+
+    // The streams of the previous run are no longer served
+    _release_host_streams(&state.run_streams);
+    state.run_streams = state.next_streams;
+    memset(&state.next_streams, 0, sizeof(ebsp_host_streams));
+
     // Write stream structs to combuf + extmem
-    for (int p = 0; p < NPROCS; p++) {
-        int nbytes = state.combuf.n_streams[p] * sizeof(ebsp_stream_descriptor);
-        void* stream_descriptors = ebsp_ext_malloc(nbytes);
-        memcpy(stream_descriptors, state.buffered_streams[p], nbytes);
-        state.combuf.extmem_streams[p] = _arm_to_e_pointer(stream_descriptors);
-
-        // TODO void*               extmem_current_out_chunk[NPROCS];
-        // TODO int                 out_buffer_size[NPROCS];
-    }
-
-    // Write communication buffer containing nprocs,
-    // messages and tagsize
-    state.combuf.nprocs = state.nprocs_used;
-    for (int i = 0; i < state.nprocs; ++i)
-        state.combuf.syncstate[i] = STATE_INIT;
-    if (!_write_extmem(&state.combuf, 0, sizeof(ebsp_combuf))) {
+    // The descriptors of all cores share one block, which is released
+    // together with the streams when the next run is prepared
+    int n_descriptors = 0;
+    for (int p = 0; p < state.tables.ncores; p++)
+        n_descriptors += state.tables.n_streams[p];
+    ebsp_stream_descriptor* stream_descriptors = NULL;
+    if (n_descriptors > 0) {
+        stream_descriptors =
+            ebsp_ext_malloc(n_descriptors * sizeof(ebsp_stream_descriptor));
+        if (stream_descriptors == NULL) {
+            fprintf(stderr, "ERROR: could not allocate stream descriptors in "
+                            "ebsp_spmd.\n");
+            return 0;
+        }
+    }
+    for (int p = 0; p < state.tables.ncores; p++) {
+        int n = state.tables.n_streams[p];
+        if (n == 0) {
+            state.tables.extmem_streams[p] = NULL;
+            continue;
+        }
+        memcpy(stream_descriptors, state.stream_vectors[p].descriptors,
+               n * sizeof(ebsp_stream_descriptor));
+        state.tables.extmem_streams[p] = _arm_to_e_pointer(stream_descriptors);
+        stream_descriptors += n;
+    }
+
+    // Write the parts of the communication buffer that the cores read
+    // before they write to it. The large arrays (variable list, requests,
+    // payloads) are only read up to a counter. The message queues and
+    // payload buffer are not written here, see ebsp_send_down.
+    state.combuf->nprocs = state.nprocs_used;
+    state.combuf->seconds_per_cycle = 1.0f / CLOCKSPEED;
+    state.combuf->dynmem = _arm_to_e_pointer(_dynmem_base(state.batch_slot));
+    for (int i = 0; i < state.rows * state.cols; ++i) {
+        state.tables.syncstate[i] = STATE_INIT;
+        state.tables.log_head[i] = 0;
+        state.tables.log_dropped[i] = 0;
+        state.tables.log_tail[i] = 0;
+    }
+    // nprocs, tagsize, dynmem and the variable counter
+    _combuf_mark_dirty(state.combuf, offsetof(ebsp_combuf, message_queue));
+    // Status block, stream pointers and log positions
+    _combuf_mark_dirty(&state.combuf->syncstate_ptr,
+                       _combuf_offset(state.tables.data_requests) -
+                           COMBUF_STATUS_OFFSET);
+    if (!_combuf_flush()) {
         fprintf(stderr, "ERROR: initial extmem write failed in ebsp_spmd.\n");
         return 0;
     }
 
+    // From now on the message queues belong to this run. In batch mode
+    // the next run is prepared in the other slot, which is no longer used
+    // because the previous run has finished.
+    state.queues_used = 1;
+    if (state.batch_mode) {
+        state.batch_slot = 1 - state.batch_slot;
+        bsp_initialized = 3;
+    }
+
     // Starting time
     clock_gettime(CLOCK_MONOTONIC, &state.ts_start);
-    _update_remote_timer();
+    _update_host_epoch();
 
     // Start the program
     // Only in DEBUG mode:
     // The program will block on bsp_begin in state STATE_EREADY
     // untill we send a STATE_CONTINUE
+    cores_idle = 0;
+    if (!_start_sink_thread())
+        return 0;
     if (e_start_group(&state.dev) != E_OK) {
         fprintf(stderr, "ERROR: e_start_group() failed.\n");
+        _stop_sink_thread();
         return 0;
     }
+    return 1;
+}
 
-    // Every iteration we only have to read the start of the buffer
-    // because that is where the syncstate flags are located
-    // We have to read everything up to remotetimer (not included)
-    const int read_size = offsetof(ebsp_combuf, remotetimer);
-
+// Handles the requests of the cores until they are finished
+static int _spmd_poll() {
 #ifdef DEBUG
     int cores_initialized;
     while (1) {
         _microsleep(1000); // 1 millisecond
 
-        // Read the communication buffer
-        if (e_read(&state.emem, 0, 0, 0, &state.combuf, read_size) !=
-            read_size) {
+        // Read the status block
+        if (!_read_status(NULL, NULL)) {
             fprintf(stderr, "ERROR: e_read ebsp_combuf failed in ebsp_spmd.\n");
             return 0;
         }
 
         // Check every core
         cores_initialized = 0;
-        for (int i = 0; i < state.nprocs; ++i)
-            if (state.combuf.syncstate[i] == STATE_EREADY)
+        for (int i = 0; i < state.rows * state.cols; ++i)
+            if (state.tables.syncstate[i] == STATE_EREADY)
                 ++cores_initialized;
-        if (cores_initialized == state.nprocs)
+        if (cores_initialized == state.rows * state.cols)
             break;
     }
     printf("(BSP) DEBUG: All epiphany cores are ready for initialization.\n");
-    printf("(BSP) DEBUG: ebsp uses %d KB = %p B of external memory.\n",
-           sizeof(ebsp_combuf) / 1024, (void*)sizeof(ebsp_combuf));
+    printf("(BSP) DEBUG: the combuf uses %u KB = %u B of external memory.\n",
+           state.combuf_size / 1024, state.combuf_size);
 
-    _update_remote_timer();
+    _update_host_epoch();
 
     // Send start signal
-    for (int i = 0; i < state.nprocs; ++i)
-        _write_core_syncstate(i, STATE_CONTINUE);
+    _write_core_syncstates(state.rows * state.cols, STATE_CONTINUE);
 #endif
 
     int total_syncs = 0;
@@ -233,36 +364,38 @@ int ebsp_spmd() {
     int continue_counter = 0;
     int abort_counter = 0;
 
+    // Syncstates as seen in the previous poll
+    // Only cores whose syncstate changed need attention
+    int8_t prev_syncstate[MAX_NPROCS];
+    for (int i = 0; i < MAX_NPROCS; i++)
+        prev_syncstate[i] = STATE_INIT;
+    _poll_reset();
+
 #ifdef DEBUG
     int iter = 0;
     printf("(BSP) DEBUG: All epiphany cores initialized.\n");
 #endif
 
     for (;;) {
-        _update_remote_timer();
-        _microsleep(1); // 1000 is 1 millisecond
-
-        // Read the first part of the communication buffer
-        // that contains sync states: read all up till coredata (not inclusive)
-        if (e_read(&state.emem, 0, 0, 0, &state.combuf, read_size) !=
-            read_size) {
+        // Read the status block, containing syncstates and interrupts
+        uint64_t changed = 0;
+        if (!_read_status(prev_syncstate, &changed)) {
             fprintf(stderr, "ERROR: e_read ebsp_combuf failed in ebsp_spmd.\n");
             return 0;
         }
 
-        // Check interrupts
-        for (int i = 0; i < state.nprocs; i++) {
-            if (state.combuf.interrupts[i] != 0) {
-                uint32_t ipend = state.combuf.interrupts[i];
-                fprintf(stderr, "WARNING: Interrupt occured on core %d: 0x%x\n",
-                        i, ipend);
-                // Reset
-                state.combuf.interrupts[i] = 0;
-                _write_extmem((void*)&state.combuf.interrupts[i],
-                              offsetof(ebsp_combuf, interrupts[i]),
-                              sizeof(uint16_t));
-            }
+        // Streams from files are refilled as the cores read them
+        if (state.run_streams.n_file_streams != 0)
+            _refill_file_streams();
+
+        if (changed == 0) {
+            // The log is printed when the host has nothing else to do
+            if (state.poll_idle >= POLL_SPIN_ITERATIONS)
+                _drain_logs();
+            _poll_backoff();
+            continue;
         }
+        _poll_reset();
 
         // Check sync states
         run_counter = 0;
@@ -270,8 +403,8 @@ int ebsp_spmd() {
         finish_counter = 0;
         continue_counter = 0;
         abort_counter = 0;
-        for (int i = 0; i < state.nprocs; i++) {
-            switch (state.combuf.syncstate[i]) {
+        for (int i = 0; i < state.rows * state.cols; i++) {
+            switch (state.tables.syncstate[i]) {
             case STATE_INIT:
                 break;
 
@@ -296,9 +429,16 @@ int ebsp_spmd() {
                 break;
 
             case STATE_MESSAGE:
-                printf("$%02d: %s\n", i, state.combuf.msgbuf);
-                fflush(stdout);
-                // Reset flag to let epiphany core continue
+                // Only a core that just entered this state has a new message
+                if ((changed & ((uint64_t)1 << i)) == 0)
+                    break;
+                // The message is the last record in the log of the core,
+                // see ebsp_message
+                _drain_logs();
+                // Reset flag in extmem first, so that a next message from
+                // this core is seen as a change, and let the core continue
+                _write_syncstates(i, 1, STATE_CONTINUE);
+                prev_syncstate[i] = STATE_CONTINUE;
                 _write_core_syncstate(i, STATE_CONTINUE);
                 break;
 
@@ -307,7 +447,7 @@ int ebsp_spmd() {
                 if (extmem_corrupted <= 32) // to avoid overflow
                     fprintf(stderr, "ERROR: External memory corrupted."
                                     " syncstate[%d] = %d.\n",
-                            i, state.combuf.syncstate[i]);
+                            i, state.tables.syncstate[i]);
                 break;
             }
         }
@@ -335,29 +475,39 @@ int ebsp_spmd() {
             if (state.sync_callback)
                 state.sync_callback();
 
+            // The cores continue with this as their new host time
+            _update_host_epoch();
+
             // First reset the combuf
+            _write_syncstates(0, state.nprocs_used, STATE_CONTINUE);
             for (int i = 0; i < state.nprocs_used; i++)
-                state.combuf.syncstate[i] = STATE_CONTINUE;
-            _write_extmem(&state.combuf.syncstate,
-                          offsetof(ebsp_combuf, syncstate),
-                          NPROCS * sizeof(int));
-            // Now write it to all cores to continue their execution
-            for (int i = 0; i < state.nprocs_used; i++)
-                _write_core_syncstate(i, STATE_CONTINUE);
+                prev_syncstate[i] = STATE_CONTINUE;
+            // Now release core 0, which releases the others
+            // (see ebsp_host_sync)
+            _write_core_syncstate(0, STATE_CONTINUE);
         }
         if (abort_counter != 0) {
+            // Includes the message of bsp_abort
+            _drain_logs();
             printf("(BSP) ERROR: bsp_abort was called\n");
             break;
         }
         if (finish_counter == state.nprocs_used)
             break;
     }
-    // Read the communication buffer
-    // to get final messages from the program
-    if (e_read(&state.emem, 0, 0, 0, &state.combuf, sizeof(ebsp_combuf)) !=
-        sizeof(ebsp_combuf)) {
-        fprintf(stderr,
-                "ERROR: e_read full ebsp_combuf failed in ebsp_spmd.\n");
+
+    _drain_logs();
+
+    // When nprocs does not fill the workgroup, the unused cores keep
+    // waiting in bsp_begin, so the cores are only idle when all were used
+    if (finish_counter == state.rows * state.cols && abort_counter == 0)
+        cores_idle = 1;
+    // Read the tagsize of the final messages from the program
+    // The messages themselves are read when they are requested,
+    // see ebsp_qsize and ebsp_move
+    if (e_read(&state.emem, 0, 0, offsetof(ebsp_combuf, tagsize),
+               &state.combuf->tagsize, sizeof(int32_t)) != sizeof(int32_t)) {
+        fprintf(stderr, "ERROR: e_read tagsize failed in ebsp_spmd.\n");
         return 0;
     }
 
@@ -368,7 +518,9 @@ int ebsp_spmd() {
     if (state.end_callback)
         state.end_callback();
 
-    bsp_initialized = 3;
+    // In batch mode this was done when the run was started
+    if (!state.batch_mode)
+        bsp_initialized = 3;
 
     if (abort_counter != 0)
         return 0;
@@ -376,6 +528,90 @@ int ebsp_spmd() {
     return 1;
 }
 
+// Runs _spmd_poll, after which the sink thread writes the last chunks
+// of the up streams with a sink
+static int _spmd_run() {
+    int result = _spmd_poll();
+    _stop_sink_thread();
+    return result;
+}
+
+int ebsp_spmd() {
+    if (!_spmd_start("ebsp_spmd"))
+        return 0;
+    return _spmd_run();
+}
+
+static void* _spmd_thread(void* arg) {
+    state.spmd_result = _spmd_run();
+    __atomic_store_n(&state.spmd_finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int ebsp_spmd_async() {
+    if (!_spmd_start("ebsp_spmd_async"))
+        return 0;
+
+    state.spmd_finished = 0;
+    state.spmd_result = 0;
+    if (pthread_create(&state.spmd_thread, NULL, _spmd_thread, NULL) != 0) {
+        fprintf(stderr, "ERROR: could not create thread in ebsp_spmd_async.\n");
+        // Let the cores run to completion in this thread instead
+        _spmd_run();
+        return 0;
+    }
+
+    // Handles are never 0, so that 0 can indicate failure
+    state.spmd_runs++;
+    if (state.spmd_runs <= 0)
+        state.spmd_runs = 1;
+    state.spmd_handle = state.spmd_runs;
+    return state.spmd_handle;
+}
+
+int ebsp_spmd_test(int handle) {
+    if (handle == 0 || handle != state.spmd_handle) {
+        fprintf(stderr, "ERROR: ebsp_spmd_test called with invalid handle.\n");
+        return -1;
+    }
+    return __atomic_load_n(&state.spmd_finished, __ATOMIC_ACQUIRE);
+}
+
+int ebsp_spmd_wait(int handle) {
+    if (handle == 0 || handle != state.spmd_handle) {
+        fprintf(stderr, "ERROR: ebsp_spmd_wait called with invalid handle.\n");
+        return 0;
+    }
+    pthread_join(state.spmd_thread, NULL);
+    state.spmd_handle = 0;
+    return state.spmd_result;
+}
+
+void ebsp_set_fast_start(int enabled) { fast_start = enabled; }
+
+int ebsp_set_batch_mode(int enabled) {
+    if (bsp_initialized != 2 && bsp_initialized != 3) {
+        fprintf(stderr, "ERROR: ebsp_set_batch_mode called before bsp_begin\n");
+        return 0;
+    }
+    if (state.spmd_handle != 0) {
+        fprintf(stderr, "ERROR: ebsp_set_batch_mode called before the "
+                        "asynchronous run was finished with ebsp_spmd_wait\n");
+        return 0;
+    }
+
+    // The memory for ebsp_ext_malloc is divided differently,
+    // so everything that was prepared for the next run is released
+    state.batch_mode = enabled;
+    state.batch_slot = 0;
+    _release_host_streams(&state.next_streams);
+    bsp_initialized = 3;
+    _prepare_next_run();
+    state.queues_used = 1;
+    _prepare_next_messages();
+    return 1;
+}
+
 int bsp_end() {
     if (bsp_initialized == 0) {
         fprintf(stderr,
@@ -383,14 +619,28 @@ int bsp_end() {
         return 0;
     }
 
-    if (bsp_initialized >= 2)
+    // An asynchronous run has to finish before the cores are released
+    if (state.spmd_handle != 0)
+        ebsp_spmd_wait(state.spmd_handle);
+    _stop_workers();
+
+    if (bsp_initialized >= 2) {
+        e_free(&state.newlib);
         e_free(&state.emem);
+    }
 
     if (E_OK != e_finalize()) {
         fprintf(stderr, "ERROR: Could not finalize the Epiphany connection.\n");
         return 0;
     }
 
+    _release_host_streams(&state.next_streams);
+    _release_host_streams(&state.run_streams);
+    free(state.combuf);
+    if (state.stream_vectors != NULL)
+        for (int p = 0; p < state.tables.ncores; p++)
+            free(state.stream_vectors[p].descriptors);
+    free(state.stream_vectors);
     memset(&state, 0, sizeof(state));
 
     bsp_initialized = 0;
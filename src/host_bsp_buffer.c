@@ -20,74 +20,169 @@ see the files COPYING and COPYING.LESSER. If not, see
 <http://www.gnu.org/licenses/>.
 */
 
+#define _LARGEFILE64_SOURCE
 #include "host_bsp_private.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 extern bsp_state_t state;
 
-#define MINIMUM_CHUNK_SIZE (4 * sizeof(int))
+#define MINIMUM_CHUNK_SIZE (4 * (int)sizeof(int))
 
-void ebsp_create_down_stream(const void* src, int dst_core_id, int nbytes,
-                             int max_chunksize) {
+// A down stream that is packed into extmem by ebsp_create_down_streams
+// Chunk c starts at c * (max_chunksize + 2 * sizeof(int)) in dst,
+// so every chunk can be packed independently of the others
+typedef struct {
+    const char* src;
+    char* dst;
+    int nbytes;
+    int max_chunksize;
+    int nchunks;
+} _down_stream;
+
+// Chunks first_chunk, ..., end_chunk - 1 of a down stream
+typedef struct {
+    _down_stream* stream;
+    int first_chunk;
+    int end_chunk;
+} _pack_task;
+
+// Copies chunks to extmem, inserting headers
+// Headers consist of 2 ints: prev size and next size
+static void _pack_chunks(void* tasks, int index) {
+    _pack_task* task = &((_pack_task*)tasks)[index];
+    _down_stream* stream = task->stream;
+    int max_chunksize = stream->max_chunksize;
+
+    for (int c = task->first_chunk; c < task->end_chunk; c++) {
+        int offset = c * max_chunksize;
+        int chunksize = stream->nbytes - offset;
+        if (chunksize > max_chunksize)
+            chunksize = max_chunksize;
+
+        int* header = (int*)(stream->dst +
+                             (size_t)c * (max_chunksize + 2 * sizeof(int)));
+        header[0] = (c == 0) ? 0 : max_chunksize; // prev header
+        header[1] = chunksize;                    // next header
+        memcpy(&header[2], stream->src + offset, chunksize);
+    }
+}
+
+void ebsp_create_down_streams(int count, const void* const* srcs,
+                              const int* dst_core_ids, const int* nbytes,
+                              int max_chunksize) {
     if (max_chunksize < MINIMUM_CHUNK_SIZE) {
         printf("ERROR: minimum chunk size is %i bytes\n", MINIMUM_CHUNK_SIZE);
         return;
     }
 
-    int nchunks = (nbytes + max_chunksize - 1) /
-                  max_chunksize; // nbytes/chunksize rounded up
-
-    int nbytes_including_headers =
-        nbytes + nchunks * 2 * sizeof(int) +
-        2 * sizeof(int); // the +2*sizeof(int) is the terminating header
-                         // headers consist of 2 ints: prev size and next size
+    for (int i = 0; i < count; i++) {
+        if (dst_core_ids[i] < 0 || dst_core_ids[i] >= state.nprocs_used) {
+            printf("ERROR: ebsp_create_down_stream called with pid %d\n",
+                   dst_core_ids[i]);
+            return;
+        }
+    }
 
-    // 1) malloc in extmem
-    void* extmem_in_buffer = ebsp_ext_malloc(nbytes_including_headers);
-    if (extmem_in_buffer == 0) {
-        printf(
-            "ERROR: not enough memory in extmem for ebsp_send_buffered_raw\n");
+    _down_stream* streams = malloc(count * sizeof(_down_stream));
+    if (streams == NULL) {
+        printf("ERROR: could not allocate memory in ebsp_create_down_stream\n");
         return;
     }
 
-    // 2) copy the data to extmem, inserting headers
-    unsigned dst_cursor = (unsigned)extmem_in_buffer;
-    unsigned src_cursor = (unsigned)src;
+    // 1) malloc in extmem, and write the terminating headers
+    int ntasks = 0;
+    int chunks_per_task = PACK_TASK_BYTES / max_chunksize;
+    if (chunks_per_task < 1)
+        chunks_per_task = 1;
+    for (int i = 0; i < count; i++) {
+        _down_stream* stream = &streams[i];
+        stream->src = srcs[i];
+        stream->nbytes = nbytes[i];
+        stream->max_chunksize = max_chunksize;
+        // nbytes/chunksize rounded up
+        stream->nchunks = (nbytes[i] + max_chunksize - 1) / max_chunksize;
 
-    int current_chunksize = max_chunksize;
-    int last_chunksize = 0;
-    for (int nbytes_left = nbytes; nbytes_left > 0;
-         nbytes_left -= max_chunksize) {
-        if (nbytes_left < max_chunksize)
-            current_chunksize = nbytes_left;
+        // the +2*sizeof(int) is the terminating header
+        int nbytes_including_headers =
+            nbytes[i] + stream->nchunks * 2 * sizeof(int) + 2 * sizeof(int);
 
-        (*(int*)dst_cursor) = last_chunksize; // write prev header
-        dst_cursor += sizeof(int);
-        (*(int*)dst_cursor) = current_chunksize; // write next header
-        dst_cursor += sizeof(int);
+        stream->dst = ebsp_ext_malloc(nbytes_including_headers);
+        if (stream->dst == 0) {
+            printf("ERROR: not enough memory in extmem for "
+                   "ebsp_create_down_stream\n");
+            for (int j = 0; j < i; j++)
+                ebsp_free(streams[j].dst);
+            free(streams);
+            return;
+        }
 
-        memcpy((void*)dst_cursor, (void*)src_cursor, current_chunksize);
+        int last_chunksize = max_chunksize;
+        if (stream->nchunks > 0)
+            last_chunksize =
+                nbytes[i] - (stream->nchunks - 1) * max_chunksize;
+        int* terminator =
+            (int*)(stream->dst + nbytes_including_headers - 2 * sizeof(int));
+        terminator[0] = last_chunksize; // prev
+        terminator[1] = 0;              // next
 
-        dst_cursor += current_chunksize;
-        src_cursor += current_chunksize;
+        ntasks += (stream->nchunks + chunks_per_task - 1) / chunks_per_task;
+    }
 
-        last_chunksize = current_chunksize;
+    // 2) copy the data to extmem, divided over the worker threads
+    _pack_task* tasks = malloc(ntasks * sizeof(_pack_task));
+    if (tasks == NULL && ntasks > 0) {
+        printf("ERROR: could not allocate memory in ebsp_create_down_stream\n");
+        for (int i = 0; i < count; i++)
+            ebsp_free(streams[i].dst);
+        free(streams);
+        return;
+    }
+    int t = 0;
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < streams[i].nchunks; c += chunks_per_task) {
+            tasks[t].stream = &streams[i];
+            tasks[t].first_chunk = c;
+            tasks[t].end_chunk = c + chunks_per_task;
+            if (tasks[t].end_chunk > streams[i].nchunks)
+                tasks[t].end_chunk = streams[i].nchunks;
+            t++;
+        }
     }
+    _parallel_for(ntasks, _pack_chunks, tasks);
+    free(tasks);
 
-    (*(int*)dst_cursor) = current_chunksize; // write terminating header (prev)
-    dst_cursor += sizeof(int);
-    (*(int*)dst_cursor) = 0; // write terminating header (next)
-    dst_cursor += sizeof(int);
+    // 3) add streams to state
+    for (int i = 0; i < count; i++) {
+        int nbytes_including_headers = streams[i].nbytes +
+                                       streams[i].nchunks * 2 * sizeof(int) +
+                                       2 * sizeof(int);
+        _ebsp_add_stream(dst_core_ids[i], streams[i].dst,
+                         nbytes_including_headers, max_chunksize, 1);
+    }
+    free(streams);
+}
 
-    // 3) add stream to state
-    _ebsp_add_stream(dst_core_id, extmem_in_buffer, nbytes_including_headers,
-                     max_chunksize, 1);
+void ebsp_create_down_stream(const void* src, int dst_core_id, int nbytes,
+                             int max_chunksize) {
+    ebsp_create_down_streams(1, &src, &dst_core_id, &nbytes, max_chunksize);
 }
 
 void ebsp_create_down_stream_raw(const void* src, int dst_core_id, int nbytes,
                                  int max_chunksize) {
+    if (dst_core_id < 0 || dst_core_id >= state.nprocs_used) {
+        printf("ERROR: ebsp_send_buffered_raw called with pid %d\n",
+               dst_core_id);
+        return;
+    }
+
     // 1) malloc in extmem
     void* extmem_in_buffer = ebsp_ext_malloc(nbytes);
     if (extmem_in_buffer == 0) {
@@ -102,11 +197,209 @@ void ebsp_create_down_stream_raw(const void* src, int dst_core_id, int nbytes,
     _ebsp_add_stream(dst_core_id, extmem_in_buffer, nbytes, max_chunksize, 1);
 }
 
+// Allocates a window of slots of `slot_size` bytes in extmem. It takes
+// about FILE_STREAM_WINDOW bytes, or less when extmem is short, and has at
+// most `max_window` slots but at least 2. The number of slots is returned
+// in `*window`.
+static char* _alloc_window(int slot_size, long long max_window, int* window) {
+    long long n = FILE_STREAM_WINDOW / slot_size;
+    if (n > max_window)
+        n = max_window;
+    if (n < 2)
+        n = 2;
+    for (; n >= 2; n /= 2) {
+        char* slots = ebsp_ext_malloc(n * slot_size);
+        if (slots != NULL) {
+            *window = n;
+            return slots;
+        }
+    }
+    return NULL;
+}
+
+// Returns a pointer to `nbytes` bytes at `position` in the stream, which
+// are mapped from the file. The file is mapped in views of FILE_STREAM_VIEW
+// bytes, so that large files also fit in the address space of the host.
+static const char* _file_view(ebsp_file_stream* stream, long long position,
+                              int nbytes) {
+    long long start = stream->offset + position;
+    if (stream->view != NULL && start >= stream->view_start &&
+        start + nbytes <= stream->view_start + (long long)stream->view_length)
+        return stream->view + (start - stream->view_start);
+
+    if (stream->view != NULL)
+        munmap(stream->view, stream->view_length);
+    long long page_size = sysconf(_SC_PAGESIZE);
+    stream->view_start = start / page_size * page_size;
+    long long length = FILE_STREAM_VIEW;
+    if (length < start - stream->view_start + nbytes)
+        length = start - stream->view_start + nbytes;
+    long long end = stream->offset + stream->nbytes;
+    if (stream->view_start + length > end)
+        length = end - stream->view_start;
+    stream->view_length = length;
+    stream->view = mmap64(NULL, stream->view_length, PROT_READ, MAP_SHARED,
+                          stream->fd, stream->view_start);
+    if (stream->view == MAP_FAILED) {
+        stream->view = NULL;
+        return NULL;
+    }
+    posix_madvise(stream->view, stream->view_length, POSIX_MADV_SEQUENTIAL);
+    return stream->view + (start - stream->view_start);
+}
+
+// Writes the next chunk of `stream` to its slot in the window. The size in
+// the header is written last, since the core waits for it to change.
+static void _fill_slot(ebsp_file_stream* stream) {
+    int max_chunksize = stream->max_chunksize;
+    int* header = (int*)(stream->slots +
+                         (stream->next_chunk % stream->window) *
+                             (max_chunksize + 2 * sizeof(int)));
+    long long position = stream->next_chunk * max_chunksize;
+    int chunksize = 0;
+    if (stream->next_chunk < stream->nchunks) {
+        chunksize = max_chunksize;
+        if (position + chunksize > stream->nbytes)
+            chunksize = stream->nbytes - position;
+        const char* src = _file_view(stream, position, chunksize);
+        if (src == NULL) {
+            // End the stream, so that the core does not wait forever
+            fprintf(stderr, "ERROR: could not map the file of a down stream "
+                            "at offset %lld.\n",
+                    stream->offset + position);
+            chunksize = 0;
+            stream->next_chunk = stream->nchunks;
+        } else {
+            memcpy(&header[2], src, chunksize);
+        }
+    }
+    header[0] = (stream->next_chunk == 0) ? 0 : max_chunksize; // prev
+    __sync_synchronize();
+    ((volatile int*)header)[1] = chunksize; // next
+    stream->next_chunk++;
+}
+
+// Puts the next chunks of the file streams in the slots that the cores
+// have read. Called by ebsp_spmd while the cores run.
+void _refill_file_streams() {
+    ebsp_host_streams* streams = &state.run_streams;
+    for (int i = 0; i < streams->n_file_streams; i++) {
+        ebsp_file_stream* stream = &streams->file_streams[i];
+        int slot_size = stream->max_chunksize + 2 * sizeof(int);
+        while (stream->next_chunk <= stream->nchunks) {
+            volatile int* header =
+                (volatile int*)(stream->slots +
+                                (stream->next_chunk % stream->window) *
+                                    slot_size);
+            if (header[1] != CHUNK_PENDING)
+                break;
+            _fill_slot(stream);
+        }
+    }
+}
+
+int ebsp_create_down_stream_from_fd(int fd, long long offset, long long nbytes,
+                                    int dst_core_id, int max_chunksize) {
+    if (max_chunksize < MINIMUM_CHUNK_SIZE) {
+        printf("ERROR: minimum chunk size is %i bytes\n", MINIMUM_CHUNK_SIZE);
+        return 0;
+    }
+    if (offset < 0 || nbytes < 0) {
+        printf("ERROR: ebsp_create_down_stream_from_fd called with offset "
+               "%lld and %lld bytes\n",
+               offset, nbytes);
+        return 0;
+    }
+    if (dst_core_id < 0 || dst_core_id >= state.nprocs_used) {
+        printf("ERROR: ebsp_create_down_stream_from_fd called with pid %d\n",
+               dst_core_id);
+        return 0;
+    }
+    _prepare_next_run();
+
+    ebsp_file_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.fd = dup(fd);
+    if (stream.fd == -1) {
+        printf("ERROR: invalid file descriptor in "
+               "ebsp_create_down_stream_from_fd\n");
+        return 0;
+    }
+    stream.offset = offset;
+    stream.nbytes = nbytes;
+    stream.max_chunksize = max_chunksize;
+    stream.nchunks = (nbytes + max_chunksize - 1) / max_chunksize;
+
+    // A stream that fits in extmem is packed at once, like any down stream
+    int slot_size = max_chunksize + 2 * sizeof(int);
+    long long nbytes_including_headers =
+        nbytes + (stream.nchunks + 1) * 2 * sizeof(int);
+    if (nbytes == 0 || nbytes_including_headers <= ebsp_ext_largest_free()) {
+        const char* src = nbytes ? _file_view(&stream, 0, nbytes) : NULL;
+        if (src == NULL && nbytes != 0) {
+            printf("ERROR: could not map the file in "
+                   "ebsp_create_down_stream_from_fd\n");
+            close(stream.fd);
+            return 0;
+        }
+        int n = nbytes;
+        int n_before = state.tables.n_streams[dst_core_id];
+        ebsp_create_down_streams(1, (const void* const*)&src, &dst_core_id,
+                                 &n, max_chunksize);
+        if (stream.view != NULL)
+            munmap(stream.view, stream.view_length);
+        close(stream.fd);
+        return state.tables.n_streams[dst_core_id] != n_before;
+    }
+
+    // Otherwise the stream gets a window
+    int window;
+    stream.slots = _alloc_window(slot_size, stream.nchunks + 1, &window);
+    if (stream.slots == NULL) {
+        printf("ERROR: not enough memory in extmem for "
+               "ebsp_create_down_stream_from_fd\n");
+        close(stream.fd);
+        return 0;
+    }
+    stream.window = window;
+
+    ebsp_host_streams* next = &state.next_streams;
+    ebsp_file_stream* streams =
+        realloc(next->file_streams,
+                (next->n_file_streams + 1) * sizeof(ebsp_file_stream));
+    ebsp_stream_descriptor* descriptor = NULL;
+    if (streams != NULL) {
+        next->file_streams = streams;
+        descriptor = _ebsp_add_stream(dst_core_id, stream.slots,
+                                      window * slot_size, max_chunksize, 1);
+    }
+    if (descriptor == NULL) {
+        printf("ERROR: could not add the stream in "
+               "ebsp_create_down_stream_from_fd\n");
+        ebsp_free(stream.slots);
+        close(stream.fd);
+        return 0;
+    }
+    descriptor->window = window;
+
+    // The first chunks are written now, the others during the run
+    for (int s = 0; s < window; s++)
+        ((int*)(stream.slots + s * slot_size))[1] = CHUNK_PENDING;
+    while (stream.next_chunk < window && stream.next_chunk <= stream.nchunks)
+        _fill_slot(&stream);
+    next->file_streams[next->n_file_streams++] = stream;
+    return 1;
+}
+
 void* ebsp_create_up_stream(int src_core_id, int nbytes, int max_chunksize) {
     if (max_chunksize < MINIMUM_CHUNK_SIZE) {
         printf("ERROR: minimum chunk size is %i bytes\n", MINIMUM_CHUNK_SIZE);
         return NULL;
     }
+    if (src_core_id < 0 || src_core_id >= state.nprocs_used) {
+        printf("ERROR: ebsp_get_buffered called with pid %d\n", src_core_id);
+        return NULL;
+    }
 
     // 1) malloc in extmem
     void* extmem_out_buffer = ebsp_ext_malloc(nbytes);
@@ -121,12 +414,222 @@ void* ebsp_create_up_stream(int src_core_id, int nbytes, int max_chunksize) {
     return extmem_out_buffer;
 }
 
-// add ebsp_stream_descriptor to state.buffered_streams, update state.n_streams
-void _ebsp_add_stream(int core_id, void* extmem_buffer, int nbytes,
-                      int max_chunksize, int is_down_stream) {
-    if (state.combuf.n_streams[core_id] == MAX_N_STREAMS) {
-        printf("ERROR: state.combuf.n_streams >= MAX_N_STREAMS\n");
+static int _create_sink_stream(
+    const char* caller, int src_core_id, int fd,
+    void (*callback)(int pid, const void* data, int nbytes, void* arg),
+    void* arg, int max_chunksize) {
+    if (max_chunksize < MINIMUM_CHUNK_SIZE) {
+        printf("ERROR: minimum chunk size is %i bytes\n", MINIMUM_CHUNK_SIZE);
+        return 0;
+    }
+    if (src_core_id < 0 || src_core_id >= state.nprocs_used) {
+        printf("ERROR: %s called with pid %d\n", caller, src_core_id);
+        return 0;
+    }
+    _prepare_next_run();
+
+    ebsp_sink_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.pid = src_core_id;
+    stream.fd = -1;
+    if (callback == NULL) {
+        stream.fd = dup(fd);
+        if (stream.fd == -1) {
+            printf("ERROR: invalid file descriptor in %s\n", caller);
+            return 0;
+        }
+    }
+    stream.callback = callback;
+    stream.arg = arg;
+    stream.max_chunksize = max_chunksize;
+
+    // The number of chunks of a sink is not known, so the window is only
+    // limited by its size in bytes
+    int slot_size = max_chunksize + 2 * sizeof(int);
+    stream.slots = _alloc_window(slot_size, LLONG_MAX, &stream.window);
+    ebsp_host_streams* next = &state.next_streams;
+    ebsp_sink_stream* streams =
+        realloc(next->sink_streams,
+                (next->n_sink_streams + 1) * sizeof(ebsp_sink_stream));
+    ebsp_stream_descriptor* descriptor = NULL;
+    if (stream.slots != NULL && streams != NULL) {
+        next->sink_streams = streams;
+        descriptor = _ebsp_add_stream(src_core_id, stream.slots,
+                                      stream.window * slot_size,
+                                      max_chunksize, 0);
+    }
+    if (descriptor == NULL) {
+        printf("ERROR: not enough memory in extmem for %s\n", caller);
+        ebsp_free(stream.slots);
+        if (stream.fd != -1)
+            close(stream.fd);
+        return 0;
+    }
+    descriptor->window = stream.window;
+
+    for (int s = 0; s < stream.window; s++)
+        ((int*)(stream.slots + s * slot_size))[0] = CHUNK_PENDING;
+    next->sink_streams[next->n_sink_streams++] = stream;
+    return 1;
+}
+
+int ebsp_create_up_stream_to_fd(int src_core_id, int fd, int max_chunksize) {
+    return _create_sink_stream("ebsp_create_up_stream_to_fd", src_core_id, fd,
+                               NULL, NULL, max_chunksize);
+}
+
+int ebsp_create_up_stream_to_callback(
+    int src_core_id,
+    void (*callback)(int pid, const void* data, int nbytes, void* arg),
+    void* arg, int max_chunksize) {
+    if (callback == NULL) {
+        printf("ERROR: ebsp_create_up_stream_to_callback called without "
+               "callback\n");
+        return 0;
+    }
+    return _create_sink_stream("ebsp_create_up_stream_to_callback",
+                               src_core_id, -1, callback, arg, max_chunksize);
+}
+
+// Writes `count` chunks to `fd` with as few system calls as possible
+static void _write_chunks(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "ERROR: could not write an up stream to its "
+                            "file.\n");
+            return;
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+// Passes the chunks that the core finished to the sink of `stream` and
+// gives their slots back to the core. Returns the number of chunks.
+static int _drain_sink(ebsp_sink_stream* stream) {
+    int slot_size = stream->max_chunksize + 2 * sizeof(int);
+    struct iovec iov[SINK_BATCH];
+    volatile int* headers[SINK_BATCH];
+    int count = 0;
+    while (count < SINK_BATCH && count < stream->window) {
+        int slot = (stream->next_slot + count) % stream->window;
+        volatile int* header = (volatile int*)(stream->slots + slot * slot_size);
+        int nbytes = header[0];
+        if (nbytes == CHUNK_PENDING)
+            break;
+        // The core writes the size after the data
+        __sync_synchronize();
+        headers[count] = header;
+        iov[count].iov_base = (char*)header + 2 * sizeof(int);
+        iov[count].iov_len = nbytes;
+        count++;
+    }
+    if (count == 0)
+        return 0;
+
+    if (stream->callback != NULL) {
+        for (int i = 0; i < count; i++)
+            stream->callback(stream->pid, iov[i].iov_base, iov[i].iov_len,
+                             stream->arg);
+    } else {
+        _write_chunks(stream->fd, iov, count);
+    }
+
+    __sync_synchronize();
+    for (int i = 0; i < count; i++)
+        headers[i][0] = CHUNK_PENDING;
+    stream->next_slot = (stream->next_slot + count) % stream->window;
+    return count;
+}
+
+// Empties the up streams with a sink until _stop_sink_thread is called
+// and all chunks have been written
+static void* _sink_thread(void* unused) {
+    ebsp_host_streams* streams = &state.run_streams;
+    for (;;) {
+        int stop = __atomic_load_n(&state.sink_stop, __ATOMIC_ACQUIRE);
+        int count = 0;
+        for (int i = 0; i < streams->n_sink_streams; i++)
+            count += _drain_sink(&streams->sink_streams[i]);
+        if (count == 0) {
+            if (stop)
+                break;
+            _microsleep(SINK_SLEEP_US);
+        }
+    }
+    return NULL;
+}
+
+// Starts the sink thread for a run, when there are up streams with a sink
+int _start_sink_thread() {
+    if (state.run_streams.n_sink_streams == 0)
+        return 1;
+    state.sink_stop = 0;
+    if (pthread_create(&state.sink_thread, NULL, _sink_thread, NULL) != 0) {
+        fprintf(stderr, "ERROR: could not create the thread for up streams "
+                        "with a sink.\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Waits until the sink thread has written the chunks of the run
+void _stop_sink_thread() {
+    if (state.run_streams.n_sink_streams == 0)
         return;
+    __atomic_store_n(&state.sink_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(state.sink_thread, NULL);
+}
+
+// Closes the files of the streams and of the sinks
+void _release_host_streams(ebsp_host_streams* streams) {
+    for (int i = 0; i < streams->n_file_streams; i++) {
+        ebsp_file_stream* stream = &streams->file_streams[i];
+        if (stream->view != NULL)
+            munmap(stream->view, stream->view_length);
+        close(stream->fd);
+    }
+    for (int i = 0; i < streams->n_sink_streams; i++)
+        if (streams->sink_streams[i].fd != -1)
+            close(streams->sink_streams[i].fd);
+    free(streams->file_streams);
+    free(streams->sink_streams);
+    memset(streams, 0, sizeof(ebsp_host_streams));
+}
+
+// add ebsp_stream_descriptor to state.stream_vectors, update state.n_streams
+ebsp_stream_descriptor* _ebsp_add_stream(int core_id, void* extmem_buffer,
+                                         int nbytes, int max_chunksize,
+                                         int is_down_stream) {
+    if (state.stream_vectors == NULL || core_id < 0 ||
+        core_id >= state.nprocs_used) {
+        printf("ERROR: can not add a stream for pid %d\n", core_id);
+        return NULL;
+    }
+    _prepare_next_run();
+
+    ebsp_stream_vector* vector = &state.stream_vectors[core_id];
+    int n = state.tables.n_streams[core_id];
+    if (n == vector->capacity) {
+        int capacity = (n == 0) ? 8 : 2 * n;
+        ebsp_stream_descriptor* descriptors = realloc(
+            vector->descriptors, capacity * sizeof(ebsp_stream_descriptor));
+        if (descriptors == NULL) {
+            printf("ERROR: could not allocate stream descriptor\n");
+            return NULL;
+        }
+        vector->descriptors = descriptors;
+        vector->capacity = capacity;
     }
 
     ebsp_stream_descriptor x;
@@ -139,7 +642,11 @@ void _ebsp_add_stream(int core_id, void* extmem_buffer, int nbytes,
     x.current_buffer = NULL;
     x.next_buffer = NULL;
     x.is_down_stream = is_down_stream;
+    x.window = 0;
+    x.opened = 0;
 
-    state.buffered_streams[core_id][state.combuf.n_streams[core_id]] = x;
-    state.combuf.n_streams[core_id]++;
+    ebsp_stream_descriptor* descriptor = &vector->descriptors[n];
+    *descriptor = x;
+    state.tables.n_streams[core_id] = n + 1;
+    return descriptor;
 }
@@ -0,0 +1,355 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "host_bsp_private.h"
+#include <e-loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Program loading for the fast start mode, see ebsp_set_fast_start
+//
+// e_load_group parses the SREC file every time a program is loaded.
+// Here the parsed program is kept in host memory, so the next bsp_begin
+// with the same file only has to copy it. It is written to the cores with
+// ebsp_write, which copies through the memory mapped local memory,
+// followed by the workgroup configuration that e_load_group also writes.
+// When the program contains a part that can not be written this way,
+// it is loaded with e_load_group instead.
+//
+// The emulator loads the program itself. When it is given an SREC file,
+// the file is still parsed and compared with the sections of the ELF file
+// next to it, so that the parser is also tested without a chip. The
+// workgroup configuration is only written on the chip.
+
+// A contiguous part of the program
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    uint32_t offset; // in program_cache.data
+} _program_segment;
+
+static struct {
+    char path[1024];
+    time_t mtime;
+    off_t file_size;
+
+    _program_segment* segments;
+    int n_segments;
+    int max_segments;
+
+    unsigned char* data;
+    uint32_t data_size;
+    uint32_t max_data_size;
+} program_cache;
+
+static void _clear_program_cache() {
+    free(program_cache.segments);
+    free(program_cache.data);
+    memset(&program_cache, 0, sizeof(program_cache));
+}
+
+// Parses `ndigits` hexadecimal digits
+static int _parse_hex(const char* str, int ndigits, uint32_t* value) {
+    *value = 0;
+    for (int i = 0; i < ndigits; i++) {
+        char c = str[i];
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else
+            return 0;
+        *value = (*value << 4) | digit;
+    }
+    return 1;
+}
+
+// Adds the data of one record to the cache, extending the last segment
+// if the record continues it
+static int _add_record(uint32_t address, const unsigned char* bytes,
+                       uint32_t nbytes) {
+    if (program_cache.data_size + nbytes > program_cache.max_data_size) {
+        uint32_t size = 2 * program_cache.max_data_size + nbytes + 4096;
+        unsigned char* data = realloc(program_cache.data, size);
+        if (data == NULL)
+            return 0;
+        program_cache.data = data;
+        program_cache.max_data_size = size;
+    }
+
+    _program_segment* last = NULL;
+    if (program_cache.n_segments > 0)
+        last = &program_cache.segments[program_cache.n_segments - 1];
+    if (last == NULL || last->address + last->size != address ||
+        last->offset + last->size != program_cache.data_size) {
+        if (program_cache.n_segments == program_cache.max_segments) {
+            int count = 2 * program_cache.max_segments + 16;
+            _program_segment* segments = realloc(
+                program_cache.segments, count * sizeof(_program_segment));
+            if (segments == NULL)
+                return 0;
+            program_cache.segments = segments;
+            program_cache.max_segments = count;
+        }
+        last = &program_cache.segments[program_cache.n_segments++];
+        last->address = address;
+        last->size = 0;
+        last->offset = program_cache.data_size;
+    }
+
+    memcpy(&program_cache.data[program_cache.data_size], bytes, nbytes);
+    program_cache.data_size += nbytes;
+    last->size += nbytes;
+    return 1;
+}
+
+// Parses the S1, S2 and S3 data records of an SREC file into the cache
+static int _parse_srec(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+
+    char line[600];
+    unsigned char bytes[256];
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), file)) {
+        if (line[0] != 'S') {
+            ok = (line[0] == '\n' || line[0] == '\r' || line[0] == 0);
+            continue;
+        }
+
+        int address_size;
+        switch (line[1]) {
+        case '1':
+            address_size = 2;
+            break;
+        case '2':
+            address_size = 3;
+            break;
+        case '3':
+            address_size = 4;
+            break;
+        default:
+            // Header, count and start address records
+            continue;
+        }
+
+        uint32_t count, address;
+        if (!_parse_hex(&line[2], 2, &count) || count < address_size + 1 ||
+            !_parse_hex(&line[4], 2 * address_size, &address)) {
+            ok = 0;
+            break;
+        }
+
+        // The checksum is the complement of the sum of all other bytes
+        uint32_t sum = count;
+        for (int i = 0; i < address_size; i++)
+            sum += (address >> (8 * i)) & 0xff;
+        uint32_t nbytes = count - address_size - 1;
+        const char* cursor = &line[4 + 2 * address_size];
+        for (uint32_t i = 0; i <= nbytes && ok; i++) {
+            uint32_t byte;
+            ok = _parse_hex(cursor, 2, &byte);
+            cursor += 2;
+            sum += byte;
+            if (i < nbytes)
+                bytes[i] = byte;
+        }
+        if (ok && (sum & 0xff) != 0xff)
+            ok = 0;
+
+        if (ok)
+            ok = _add_record(address, bytes, nbytes);
+    }
+    fclose(file);
+
+    if (!ok)
+        fprintf(stderr, "ERROR: could not parse %s.\n", path);
+    return ok;
+}
+
+// Makes sure that the cache holds the program at `path`
+static int _cache_program(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return 0;
+
+    if (strcmp(program_cache.path, path) == 0 &&
+        program_cache.mtime == info.st_mtime &&
+        program_cache.file_size == info.st_size)
+        return 1;
+
+    _clear_program_cache();
+    if (!_parse_srec(path)) {
+        _clear_program_cache();
+        return 0;
+    }
+    snprintf(program_cache.path, sizeof(program_cache.path), "%s", path);
+    program_cache.mtime = info.st_mtime;
+    program_cache.file_size = info.st_size;
+    return 1;
+}
+
+#ifdef EBSP_EMULATOR
+
+// The emulator also loads ELF files, which are not parsed
+static int _is_srec(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+    int first = fgetc(file);
+    fclose(file);
+    return first == 'S';
+}
+
+// Checks that the cache holds the sections of the ELF file of the program
+static int _check_program() {
+    size_t size = 0;
+    for (int i = 0; i < program_cache.n_segments; i++) {
+        _program_segment* s = &program_cache.segments[i];
+        if (!_program_bytes_match(s->address, &program_cache.data[s->offset],
+                                  s->size)) {
+            fprintf(stderr, "ERROR: the SREC file of the program does not "
+                            "match its ELF file at address 0x%x.\n",
+                    s->address);
+            return 0;
+        }
+        size += s->size;
+    }
+    if (size != _program_image_size()) {
+        fprintf(stderr, "ERROR: the SREC file of the program has %u bytes, "
+                        "its ELF file %u.\n",
+                (unsigned)size, (unsigned)_program_image_size());
+        return 0;
+    }
+    return 1;
+}
+
+#else
+
+static int _is_local(_program_segment* s) {
+    return s->address + s->size <= LOCAL_MEMORY_SIZE;
+}
+
+static int _is_newlib(_program_segment* s) {
+    return s->address >= E_EXTMEM_ADDR &&
+           s->address + s->size <= E_EXTMEM_ADDR + NEWLIB_SIZE;
+}
+
+// The workgroup configuration of a core, which e-lib reads as
+// e_group_config and e_emem_config. e_load_group writes it to every core
+// after the program, at the same addresses.
+#define CORE_CONFIG_ADDRESS 0x28
+typedef struct {
+    uint32_t objtype;           // e_group_config, 0x28
+    uint32_t chiptype;          // 0x2c
+    uint32_t group_id;          // 0x30
+    uint32_t group_row;         // 0x34
+    uint32_t group_col;         // 0x38
+    uint32_t group_rows;        // 0x3c
+    uint32_t group_cols;        // 0x40
+    uint32_t core_row;          // 0x44
+    uint32_t core_col;          // 0x48
+    uint32_t alignment_padding; // 0x4c
+    uint32_t emem_objtype;      // e_emem_config, 0x50
+    uint32_t emem_base;         // 0x54
+} _core_config;
+
+// Writes the workgroup configuration to every core of the workgroup,
+// where `emem` is the external memory starting at E_EXTMEM_ADDR
+static int _write_core_config(const e_mem_t* emem) {
+    _core_config config;
+    config.objtype = E_EPI_GROUP;
+    config.chiptype = state.dev.type;
+    config.group_id = state.dev.base_coreid;
+    config.group_row = state.dev.row;
+    config.group_col = state.dev.col;
+    config.group_rows = state.dev.rows;
+    config.group_cols = state.dev.cols;
+    config.alignment_padding = 0xdeadbeef;
+    config.emem_objtype = E_EXT_MEM;
+    config.emem_base = emem->ephy_base;
+
+    int ncores = state.rows * state.cols;
+    for (int pid = 0; pid < ncores; pid++) {
+        int row, col;
+        _get_p_coords(pid, &row, &col);
+        config.core_row = row;
+        config.core_col = col;
+        if (!ebsp_write(pid, &config, CORE_CONFIG_ADDRESS, sizeof(config)))
+            return 0;
+    }
+    return 1;
+}
+
+// Writes the cached program to every core of the workgroup
+static int _write_program() {
+    for (int i = 0; i < program_cache.n_segments; i++) {
+        _program_segment* s = &program_cache.segments[i];
+        if (!_is_local(s) && !_is_newlib(s))
+            return 0;
+    }
+
+    // Code and data in external memory are shared by all cores
+    e_mem_t newlib_mem;
+    if (e_alloc(&newlib_mem, 0, NEWLIB_SIZE) != E_OK)
+        return 0;
+
+    int ncores = state.rows * state.cols;
+    int ok = 1;
+    for (int i = 0; i < program_cache.n_segments && ok; i++) {
+        _program_segment* s = &program_cache.segments[i];
+        unsigned char* data = &program_cache.data[s->offset];
+        if (_is_local(s)) {
+            for (int pid = 0; pid < ncores && ok; pid++)
+                ok = ebsp_write(pid, data, s->address, s->size);
+        } else {
+            ok = e_write(&newlib_mem, 0, 0, s->address - E_EXTMEM_ADDR, data,
+                         s->size) == s->size;
+        }
+    }
+    if (ok)
+        ok = _write_core_config(&newlib_mem);
+    e_free(&newlib_mem);
+    return ok;
+}
+
+#endif
+
+int _load_program(const char* path) {
+#ifdef EBSP_EMULATOR
+    if (_is_srec(path) && !(_cache_program(path) && _check_program()))
+        return 0;
+#else
+    // e_load_group is used when the program can not be loaded from the cache
+    if (_cache_program(path) && _write_program())
+        return 1;
+#endif
+    return e_load_group((char*)path, &state.dev, 0, 0, state.rows,
+                        state.cols, E_FALSE) == E_OK;
+}
@@ -0,0 +1,307 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "host_bsp_private.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+// Log of the cores, see ebsp_log
+//
+// Every core writes records with the address of a printf format and the
+// arguments to its own ring in the combuf. The host formats them here,
+// so the cores never run printf. The format and the strings of %s are read
+// from the memory of the cores when they are printed, external memory
+// through the mappings of state.newlib and state.emem and the local memory
+// of a core through state.dev. On the emulator the cores run in the host
+// process, so addresses outside external memory can be used directly. The
+// ELF file of the e-program is only used when the memory can not be read.
+
+// Copies the string at `offset` in the mapping `mem` to `buf`
+// Returns 0 when it can not be read
+static int _extmem_string(e_mem_t* mem, off_t offset, char* buf, int size) {
+    int nbytes = size - 1;
+    if (offset + nbytes > (off_t)mem->emap_size)
+        nbytes = mem->emap_size - offset;
+    if (e_read(mem, 0, 0, offset, buf, nbytes) != nbytes)
+        return 0;
+    buf[nbytes] = '\0';
+    return 1;
+}
+
+#ifndef EBSP_EMULATOR
+// Copies the string at `address` in the memory of core `pid` to `buf`,
+// where `address` is local or global. The local memory of a workgroup
+// core is read through its mapping in state.dev.core[row][col].mems.
+// Returns 0 when the address is not in the local memory of a core of
+// the workgroup or when it can not be read
+static int _core_string(int pid, uintptr_t address, char* buf, int size) {
+    int row, col;
+    unsigned int coreid = address >> 20;
+    if (coreid == 0) {
+        _get_p_coords(pid, &row, &col);
+    } else {
+        row = (int)(coreid >> 6) - (int)state.dev.row;
+        col = (int)(coreid & 0x3f) - (int)state.dev.col;
+        if (row < 0 || row >= (int)state.dev.rows || col < 0 ||
+            col >= (int)state.dev.cols)
+            return 0;
+        address &= 0xfffff;
+    }
+    if (address >= LOCAL_MEMORY_SIZE)
+        return 0;
+    int nbytes = size - 1;
+    if (address + nbytes > LOCAL_MEMORY_SIZE)
+        nbytes = LOCAL_MEMORY_SIZE - address;
+    if (e_read(&state.dev, row, col, address, buf, nbytes) != nbytes)
+        return 0;
+    buf[nbytes] = '\0';
+    return 1;
+}
+#endif
+
+// Copies the string at `address` on core `pid` to `buf`
+static void _log_string(int pid, uintptr_t address, char* buf, int size) {
+    if (address == 0) {
+        snprintf(buf, size, "(null)");
+        return;
+    }
+    // Strings in external memory: EXT_MEM_RO data, the newlib heap,
+    // the combuf and the memory of ebsp_ext_malloc
+    if (address >= E_EXTMEM_ADDR && address < E_COMBUF_ADDR &&
+        _extmem_string(&state.newlib, address - E_EXTMEM_ADDR, buf, size))
+        return;
+    if (address >= E_COMBUF_ADDR && address < E_EXTMEM_ADDR + EXTMEM_SIZE &&
+        _extmem_string(&state.emem, address - E_COMBUF_ADDR, buf, size))
+        return;
+#ifdef EBSP_EMULATOR
+    (void)pid;
+    if (address < E_EXTMEM_ADDR || address >= E_EXTMEM_ADDR + EXTMEM_SIZE) {
+        snprintf(buf, size, "%s", (const char*)address);
+        return;
+    }
+#else
+    if (_core_string(pid, address, buf, size))
+        return;
+    const char* string = _program_string(address);
+    if (string != NULL) {
+        snprintf(buf, size, "%s", string);
+        return;
+    }
+#endif
+    snprintf(buf, size, "(string at %p)", (void*)address);
+}
+
+// Keeps `*length` within a buffer of `size` bytes after snprintf
+static void _log_advance(int* length, int written, int size) {
+    if (written > 0)
+        *length += written;
+    if (*length > size - 1)
+        *length = size - 1;
+}
+
+// Formats a message of core `pid` into `out`, with the format at address
+// `format` on the core and `nargs` bytes of arguments at `args`
+static void _log_format(int pid, uintptr_t format_address, const char* args,
+                        unsigned int nargs, char* out, int size) {
+    char format[256];
+    _log_string(pid, format_address, format, sizeof(format));
+
+    unsigned int pos = 0;
+    int lost = 0; // the core did not store the arguments from here on
+    int length = 0;
+    const char* cursor = format;
+    for (;;) {
+        const char* text = cursor;
+        const char* spec;
+        int stars;
+        int type = ebsp_log_next_arg(&cursor, &spec, &stars);
+        _log_advance(&length,
+                     snprintf(out + length, size - length, "%.*s",
+                              (int)(spec - text), text),
+                     size);
+        if (type == LOG_ARG_END)
+            break;
+
+        // Same layout as _log_pack_args on the core
+        int nbytes = ebsp_log_arg_size(type);
+        unsigned int end = pos + stars * sizeof(int);
+        if (nbytes == 8)
+            end = EBSP_ALIGN(end, 8);
+        if (end + nbytes > nargs)
+            lost = 1;
+
+        // A width or precision given by an argument is put in the
+        // conversion, where a negative precision counts as no precision.
+        // The value is passed as a double and %lc as an int, so their
+        // length modifiers are left out
+        char conversion[64];
+        int clength = 0;
+        for (const char* c = spec;
+             c < cursor && clength < (int)sizeof(conversion) - 16; c++) {
+            if ((*c == 'L' && type == LOG_ARG_LDOUBLE) ||
+                (*c == 'l' && cursor[-1] == 'c'))
+                continue;
+            if (*c != '*' || lost) {
+                conversion[clength++] = *c;
+                continue;
+            }
+            int star;
+            memcpy(&star, args + pos, sizeof(int));
+            pos += sizeof(int);
+            if (star < 0 && clength > 0 && conversion[clength - 1] == '.')
+                clength--;
+            else
+                clength += snprintf(conversion + clength,
+                                    sizeof(conversion) - clength, "%d", star);
+        }
+        conversion[clength] = '\0';
+
+        // Wide strings are not read from the core, the conversion
+        // is printed instead
+        if (type == LOG_ARG_NONE || type == LOG_ARG_WSTRING || lost) {
+            if (!lost)
+                pos = end + nbytes;
+            // %% is printed as %, anything else as it is
+            if (strcmp(conversion, "%%") == 0)
+                snprintf(conversion, sizeof(conversion), "%%");
+            _log_advance(&length,
+                         snprintf(out + length, size - length, "%s",
+                                  conversion),
+                         size);
+            continue;
+        }
+
+        union {
+            int i;
+            long l;
+            long long ll;
+            double d;
+            void* p;
+        } value;
+        pos = end;
+        memcpy(&value, args + pos, nbytes);
+        pos += nbytes;
+
+        int written = 0;
+        switch (type) {
+        case LOG_ARG_INT:
+            written = snprintf(out + length, size - length, conversion, value.i);
+            break;
+        case LOG_ARG_LONG:
+            written = snprintf(out + length, size - length, conversion, value.l);
+            break;
+        case LOG_ARG_LLONG:
+            written =
+                snprintf(out + length, size - length, conversion, value.ll);
+            break;
+        case LOG_ARG_DOUBLE:
+        case LOG_ARG_LDOUBLE:
+            written = snprintf(out + length, size - length, conversion, value.d);
+            break;
+        case LOG_ARG_POINTER:
+            written = snprintf(out + length, size - length, conversion, value.p);
+            break;
+        case LOG_ARG_STRING: {
+            char string[128];
+            _log_string(pid, (uintptr_t)value.p, string, sizeof(string));
+            written =
+                snprintf(out + length, size - length, conversion, string);
+            break;
+        }
+        }
+        _log_advance(&length, written, size);
+    }
+}
+
+// Prints the records that the cores added to their log since the last call
+void _drain_logs() {
+    int ncores = state.tables.ncores;
+    // log_head followed by log_dropped
+    uint32_t heads[2 * MAX_NPROCS];
+    int nbytes = 2 * ncores * sizeof(uint32_t);
+    if (e_read(&state.emem, 0, 0, _combuf_offset(state.tables.log_head),
+               heads, nbytes) != nbytes)
+        return;
+
+    int printed = 0;
+    for (int pid = 0; pid < ncores; pid++) {
+        uint32_t* tail = &state.tables.log_tail[pid];
+        uint32_t head = heads[pid];
+        uint32_t dropped = heads[ncores + pid];
+        if (head == *tail && dropped == state.tables.log_dropped[pid])
+            continue;
+
+        // A core never gets more than LOG_RECORDS records ahead of the
+        // host, unless extmem was corrupted
+        if (head - *tail > LOG_RECORDS)
+            *tail = head - LOG_RECORDS;
+        while (*tail != head) {
+            ebsp_log_record record;
+            ebsp_log_record* src =
+                &state.tables
+                     .log_records[pid * LOG_RECORDS + *tail % LOG_RECORDS];
+            if (e_read(&state.emem, 0, 0, _combuf_offset(src), &record,
+                       sizeof(record)) != sizeof(record))
+                break;
+            // A message continues in the next records when its arguments
+            // do not fit in one, see _log_write on the core
+            uint32_t nrecords = record.nrecords;
+            if (nrecords > head - *tail)
+                nrecords = head - *tail;
+            if (nrecords > LOG_MAX_ARG_WORDS / LOG_ARG_WORDS)
+                nrecords = LOG_MAX_ARG_WORDS / LOG_ARG_WORDS;
+            if (nrecords == 0) {
+                // The rest of a message that was skipped
+                (*tail)++;
+                continue;
+            }
+            uint32_t args[LOG_MAX_ARG_WORDS];
+            memcpy(args, record.args, sizeof(record.args));
+            for (uint32_t r = 1; r < nrecords; r++) {
+                src = &state.tables.log_records[pid * LOG_RECORDS +
+                                                (*tail + r) % LOG_RECORDS];
+                if (e_read(&state.emem, 0, 0, _combuf_offset(src->args),
+                           &args[r * LOG_ARG_WORDS], sizeof(record.args)) !=
+                    sizeof(record.args)) {
+                    nrecords = r;
+                    break;
+                }
+            }
+            char line[256];
+            _log_format(pid, (uintptr_t)record.format, (const char*)args,
+                        nrecords * sizeof(record.args), line, sizeof(line));
+            printf("$%02d: %s\n", pid, line);
+            *tail += nrecords;
+        }
+        if (dropped != state.tables.log_dropped[pid]) {
+            printf("$%02d: (%u log records dropped, the log was full)\n", pid,
+                   dropped - state.tables.log_dropped[pid]);
+            state.tables.log_dropped[pid] = dropped;
+        }
+        _write_extmem(tail, _combuf_offset(tail), sizeof(uint32_t));
+        printed = 1;
+    }
+    if (printed)
+        fflush(stdout);
+}
@@ -25,24 +25,70 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include "host_bsp_private.h"
 
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 
 //
 // Host version of ebsp memory allocation functions
-// Can only be used when epiphany cores are not running
+// Can only be used when epiphany cores are not running, or in batch mode
+// when the cores use the other slot
 //
 
-// Should be called once on host after state.host_dynmem_addr has been set
+// Size of the memory for ebsp_ext_malloc of one run
+static unsigned int _dynmem_size() {
+    unsigned int size = EXTMEM_SIZE - NEWLIB_SIZE - state.combuf_size;
+    if (state.batch_mode)
+        size = (size / 2) & ~7;
+    return size;
+}
+
+// Start of the memory for ebsp_ext_malloc of the runs in `slot`,
+// which is always 0 outside of batch mode
+void* _dynmem_base(int slot) {
+    return (char*)state.host_dynmem_addr + slot * _dynmem_size();
+}
+
+// Initializes the memory of the next run
+// Should be called after state.host_dynmem_addr has been set
 void ebsp_malloc_init() {
-    return _init_malloc_state(state.host_dynmem_addr, DYNMEM_SIZE);
+    return _init_malloc_state(_dynmem_base(state.batch_slot), _dynmem_size());
 }
 
 void* ebsp_ext_malloc(unsigned int nbytes) {
-    return _malloc(state.host_dynmem_addr, nbytes);
+    _prepare_next_run();
+    return _malloc(_dynmem_base(state.batch_slot), nbytes);
+}
+
+unsigned int ebsp_ext_largest_free() {
+    return _largest_free_block(_dynmem_base(state.batch_slot));
 }
 
-void ebsp_free(void* ptr) { return _free(state.host_dynmem_addr, ptr); }
+void ebsp_free(void* ptr) {
+    int slot = 0;
+    if (state.batch_mode && (char*)ptr >= (char*)_dynmem_base(1))
+        slot = 1;
+    return _free(_dynmem_base(slot), ptr);
+}
+
+// Host pointer to `size` bytes at local address `addr` of core `pid`,
+// through the memory mapped local memory of the core. Returns NULL if that
+// part of the core is not mapped, in which case e_read and e_write are used.
+static void* _mapped_core_address(int pid, off_t addr, int size) {
+    int prow, pcol;
+    _get_p_coords(pid, &prow, &pcol);
+    e_mmap_t* mems = &state.dev.core[prow][pcol].mems;
+    if (mems->base == NULL || addr < 0 || addr + size > (off_t)mems->map_size)
+        return NULL;
+    return (char*)mems->base + addr;
+}
 
 int ebsp_write(int pid, void* src, off_t dst, int size) {
+    void* mapped = _mapped_core_address(pid, dst, size);
+    if (mapped) {
+        memcpy(mapped, src, size);
+        return 1;
+    }
+
     int prow, pcol;
     _get_p_coords(pid, &prow, &pcol);
     if (e_write(&state.dev, prow, pcol, dst, src, size) != size) {
@@ -55,6 +101,12 @@ int ebsp_write(int pid, void* src, off_t dst, int size) {
 }
 
 int ebsp_read(int pid, off_t src, void* dst, int size) {
+    void* mapped = _mapped_core_address(pid, src, size);
+    if (mapped) {
+        memcpy(dst, mapped, size);
+        return 1;
+    }
+
     int prow, pcol;
     _get_p_coords(pid, &prow, &pcol);
     if (e_read(&state.dev, prow, pcol, src, dst, size) != size) {
@@ -66,8 +118,96 @@ int ebsp_read(int pid, off_t src, void* dst, int size) {
     return 1;
 }
 
+int ebsp_writev(const ebsp_transfer* transfers, int count) {
+    int ret = 1;
+    for (int i = 0; i < count; i++) {
+        const ebsp_transfer* t = &transfers[i];
+        if (!ebsp_write(t->pid, t->buffer, t->address, t->size))
+            ret = 0;
+    }
+    return ret;
+}
+
+int ebsp_readv(const ebsp_transfer* transfers, int count) {
+    int ret = 1;
+    for (int i = 0; i < count; i++) {
+        const ebsp_transfer* t = &transfers[i];
+        if (!ebsp_read(t->pid, t->address, t->buffer, t->size))
+            ret = 0;
+    }
+    return ret;
+}
+
+int ebsp_write_all(void* src, off_t dst, int size) {
+    int ret = 1;
+    for (int pid = 0; pid < state.nprocs_used; pid++)
+        if (!ebsp_write(pid, src, dst, size))
+            ret = 0;
+    return ret;
+}
+
 int _write_core_syncstate(int pid, int syncstate) {
-    return ebsp_write(pid, &syncstate, (off_t)state.combuf.syncstate_ptr, 4);
+    int8_t s = syncstate;
+    return ebsp_write(pid, &s, (off_t)state.combuf->syncstate_ptr, 1);
+}
+
+// Sets the syncstate on cores 0, ..., count - 1
+int _write_core_syncstates(int count, int syncstate) {
+    int8_t s = syncstate;
+    int ret = 1;
+    for (int pid = 0; pid < count; pid++)
+        if (!ebsp_write(pid, &s, (off_t)state.combuf->syncstate_ptr, 1))
+            ret = 0;
+    return ret;
+}
+
+// Sets syncstate of cores first, ..., first + count - 1 in extmem
+// (and in the local copy) with a single write
+int _write_syncstates(int first, int count, int8_t syncstate) {
+    for (int i = first; i < first + count; i++)
+        state.tables.syncstate[i] = syncstate;
+    int ret = _write_extmem(&state.tables.syncstate[first],
+                            _combuf_offset(&state.tables.syncstate[first]),
+                            count);
+    // Make sure this write is done before any write to the cores
+    __sync_synchronize();
+    return ret;
+}
+
+// Reads the status block of the combuf into state.combuf
+// Sets `changed` to a bitmap of the cores whose syncstate differs from
+// `prev` and updates `prev`. Returns 0 on error.
+// Interrupts reported by the cores are handled here as well.
+int _read_status(int8_t* prev, uint64_t* changed) {
+    int size = _combuf_offset(&state.tables.interrupts[state.tables.ncores]) -
+               COMBUF_STATUS_OFFSET;
+    if (e_read(&state.emem, 0, 0, COMBUF_STATUS_OFFSET,
+               (char*)state.combuf + COMBUF_STATUS_OFFSET, size) != size)
+        return 0;
+
+    for (int i = 0; i < state.rows * state.cols; i++) {
+        if (state.tables.interrupts[i] != 0) {
+            uint32_t ipend = state.tables.interrupts[i];
+            fprintf(stderr, "WARNING: Interrupt occured on core %d: 0x%x\n", i,
+                    ipend);
+            // Reset
+            state.tables.interrupts[i] = 0;
+            _write_extmem((void*)&state.tables.interrupts[i],
+                          _combuf_offset(&state.tables.interrupts[i]),
+                          sizeof(uint16_t));
+        }
+    }
+
+    if (prev) {
+        *changed = 0;
+        for (int i = 0; i < state.rows * state.cols; i++) {
+            if (state.tables.syncstate[i] != prev[i]) {
+                *changed |= (uint64_t)1 << i;
+                prev[i] = state.tables.syncstate[i];
+            }
+        }
+    }
+    return 1;
 }
 
 int _write_extmem(void* src, off_t offset, int size) {
@@ -79,3 +219,57 @@ int _write_extmem(void* src, off_t offset, int size) {
     return 1;
 }
 
+
+// Offset in extmem of `ptr` in the local copy state.combuf
+off_t _combuf_offset(const void* ptr) {
+    return (const char*)ptr - (const char*)state.combuf;
+}
+
+// Marks `size` bytes at `ptr` in state.combuf as changed by the host,
+// so that _combuf_flush writes them to extmem
+void _combuf_mark_dirty(void* ptr, int size) {
+    int start = (int)_combuf_offset(ptr);
+    int end = start + size;
+
+    // Absorb every region that overlaps or nearly touches this one
+    for (int i = 0; i < state.n_dirty_regions;) {
+        ebsp_combuf_region* r = &state.dirty_regions[i];
+        if (r->start <= end + DIRTY_REGION_GAP &&
+            start <= r->end + DIRTY_REGION_GAP) {
+            if (r->start < start)
+                start = r->start;
+            if (r->end > end)
+                end = r->end;
+            *r = state.dirty_regions[--state.n_dirty_regions];
+        } else {
+            i++;
+        }
+    }
+
+    // Out of regions: fall back to a single region covering all of them
+    if (state.n_dirty_regions == MAX_DIRTY_REGIONS) {
+        for (int i = 0; i < state.n_dirty_regions; i++) {
+            if (state.dirty_regions[i].start < start)
+                start = state.dirty_regions[i].start;
+            if (state.dirty_regions[i].end > end)
+                end = state.dirty_regions[i].end;
+        }
+        state.n_dirty_regions = 0;
+    }
+
+    state.dirty_regions[state.n_dirty_regions].start = start;
+    state.dirty_regions[state.n_dirty_regions].end = end;
+    state.n_dirty_regions++;
+}
+
+// Writes the parts of state.combuf marked by _combuf_mark_dirty to extmem
+int _combuf_flush() {
+    for (int i = 0; i < state.n_dirty_regions; i++) {
+        ebsp_combuf_region* r = &state.dirty_regions[i];
+        if (!_write_extmem((char*)state.combuf + r->start, r->start,
+                           r->end - r->start))
+            return 0;
+    }
+    state.n_dirty_regions = 0;
+    return 1;
+}
@@ -28,66 +28,131 @@ see the files COPYING and COPYING.LESSER. If not, see
 extern bsp_state_t state;
 
 void ebsp_set_tagsize(int* tag_bytes) {
-    int oldsize = state.combuf.tagsize;
-    state.combuf.tagsize = *tag_bytes;
+    // Before bsp_begin there is no local combuf yet
+    int* tagsize = state.combuf ? &state.combuf->tagsize : &state.tagsize;
+    int oldsize = *tagsize;
+    *tagsize = *tag_bytes;
     *tag_bytes = oldsize;
 }
 
-// TODO: Do not use the local copy state.combuf
-// Instead, copy directly to the memory mapped external memory
+// Messages are written to and read from the memory mapped combuf
+// in external memory directly, the local copy state.combuf is not used
+// for them. After ebsp_spmd only the headers and payloads that are
+// actually used are read.
+
+// The queue of messages sent by the cores, or NULL when external memory
+// is not mapped (before bsp_begin or after bsp_end)
+static ebsp_message_queue* _up_queue() {
+    if (state.host_combuf_addr == NULL)
+        return NULL;
+    return &((ebsp_combuf*)state.host_combuf_addr)->message_queue[0];
+}
 
-// Convert pointers pointing to the local copy state.combuf
-// to epiphany address space and back
+// Reserves `count` messages with a total of `nbytes` bytes of payload
+// (without the tags) in the down-queue. Returns the index of the first
+// message and sets `payload_offset`, or returns -1 if the messages do not
+// fit.
+static int _reserve_down_messages(int count, unsigned int nbytes,
+                                  unsigned int* payload_offset,
+                                  const char* caller) {
+    if (state.host_combuf_addr == NULL) {
+        fprintf(stderr, "ERROR: %s called before bsp_begin.\n", caller);
+        return -1;
+    }
+    // The cores use the queues until the run has finished
+    if (state.spmd_handle != 0) {
+        fprintf(stderr, "ERROR: %s called before the asynchronous run was "
+                        "finished with ebsp_spmd_wait.\n",
+                caller);
+        return -1;
+    }
+    _prepare_next_run();
+    _prepare_next_messages();
+    nbytes += count * state.combuf->tagsize;
+
+    ebsp_combuf* combuf = (ebsp_combuf*)state.host_combuf_addr;
+    ebsp_message_queue* q = &combuf->message_queue[0];
+    unsigned int index = q->count;
+    *payload_offset = combuf->data_payloads.buffer_size;
 
-void* _pointer_to_e(void* ptr) {
-    return (void*)((unsigned int)ptr - (unsigned)&state.combuf + E_COMBUF_ADDR);
+    if (index + count > MAX_MESSAGES) {
+        fprintf(stderr, "ERROR: Maximal message count reached in %s.\n",
+                caller);
+        return -1;
+    }
+    if (*payload_offset + nbytes > MAX_PAYLOAD_SIZE) {
+        fprintf(stderr, "ERROR: Maximal data payload sent in %s.\n", caller);
+        return -1;
+    }
+
+    q->count = index + count;
+    combuf->data_payloads.buffer_size = *payload_offset + nbytes;
+    return index;
 }
 
-void* _pointer_to_arm(void* ptr) {
-    return (void*)((unsigned int)ptr - E_COMBUF_ADDR + (unsigned)&state.combuf);
+// Writes a message to a reserved slot of the down-queue
+// Returns the payload offset of the next message
+static unsigned int _write_down_message(unsigned int index,
+                                        unsigned int payload_offset, int pid,
+                                        const void* tag, const void* payload,
+                                        int nbytes) {
+    ebsp_combuf* combuf = (ebsp_combuf*)state.host_combuf_addr;
+    ebsp_message_header* m = &combuf->message_queue[0].message[index];
+    char* tag_ptr = &combuf->data_payloads.buf[payload_offset];
+    char* payload_ptr = tag_ptr + state.combuf->tagsize;
+
+    memcpy(tag_ptr, tag, state.combuf->tagsize);
+    memcpy(payload_ptr, payload, nbytes);
+
+    m->pid = pid;
+    m->tag = _arm_to_e_pointer(tag_ptr);
+    m->payload = _arm_to_e_pointer(payload_ptr);
+    m->nbytes = nbytes;
+
+    return payload_offset + state.combuf->tagsize + nbytes;
 }
 
 void ebsp_send_down(int pid, const void* tag, const void* payload, int nbytes) {
-    ebsp_message_queue* q = &state.combuf.message_queue[0];
-    unsigned int index = q->count;
-    unsigned int payload_offset = state.combuf.data_payloads.buffer_size;
-    unsigned int total_nbytes = state.combuf.tagsize + nbytes;
-    void* tag_ptr;
-    void* payload_ptr;
-
-    if (index >= MAX_MESSAGES) {
-        fprintf(stderr,
-                "ERROR: Maximal message count reached in ebsp_send_down.\n");
+    unsigned int payload_offset;
+    int index = _reserve_down_messages(1, nbytes, &payload_offset,
+                                       "ebsp_send_down");
+    if (index < 0)
         return;
-    }
-    if (payload_offset + total_nbytes > MAX_PAYLOAD_SIZE) {
-        fprintf(stderr,
-                "ERROR: Maximal data payload sent in ebsp_send_down.\n");
-        return;
-    }
+    _write_down_message(index, payload_offset, pid, tag, payload, nbytes);
+}
 
-    q->count++;
-    state.combuf.data_payloads.buffer_size += total_nbytes;
+void ebsp_send_down_many(int count, const int* pids, const void* tags,
+                         const void* const* payloads, const int* nbytes) {
+    unsigned int total_nbytes = 0;
+    for (int i = 0; i < count; i++)
+        total_nbytes += nbytes[i];
 
-    tag_ptr = &state.combuf.data_payloads.buf[payload_offset];
-    payload_offset += state.combuf.tagsize;
-    payload_ptr = &state.combuf.data_payloads.buf[payload_offset];
+    unsigned int payload_offset;
+    int index = _reserve_down_messages(count, total_nbytes, &payload_offset,
+                                       "ebsp_send_down_many");
+    if (index < 0)
+        return;
 
-    q->message[index].pid = pid;
-    q->message[index].tag = _pointer_to_e(tag_ptr);
-    q->message[index].payload = _pointer_to_e(payload_ptr);
-    q->message[index].nbytes = nbytes;
-    memcpy(tag_ptr, tag, state.combuf.tagsize);
-    memcpy(payload_ptr, payload, nbytes);
+    const char* tag = tags;
+    for (int i = 0; i < count; i++) {
+        payload_offset = _write_down_message(index + i, payload_offset,
+                                             pids[i], tag, payloads[i],
+                                             nbytes[i]);
+        tag += state.combuf->tagsize;
+    }
 }
 
-int ebsp_get_tagsize() { return state.combuf.tagsize; }
+int ebsp_get_tagsize() {
+    return state.combuf ? state.combuf->tagsize : state.tagsize;
+}
 
 void ebsp_qsize(int* packets, int* accum_bytes) {
     *packets = 0;
     *accum_bytes = 0;
 
-    ebsp_message_queue* q = &state.combuf.message_queue[0];
+    ebsp_message_queue* q = _up_queue();
+    if (q == NULL)
+        return;
     int mindex = state.message_index;
     int qsize = q->count;
 
@@ -100,8 +165,8 @@ void ebsp_qsize(int* packets, int* accum_bytes) {
 }
 
 ebsp_message_header* _next_queue_message() {
-    ebsp_message_queue* q = &state.combuf.message_queue[0];
-    if (state.message_index < q->count)
+    ebsp_message_queue* q = _up_queue();
+    if (q != NULL && state.message_index < q->count)
         return &q->message[state.message_index];
     return 0;
 }
@@ -115,7 +180,7 @@ void ebsp_get_tag(int* status, void* tag) {
         return;
     }
     *status = m->nbytes;
-    memcpy(tag, _pointer_to_arm(m->tag), state.combuf.tagsize);
+    memcpy(tag, _e_to_arm_pointer(m->tag), state.combuf->tagsize);
 }
 
 void ebsp_move(void* payload, int buffer_size) {
@@ -132,7 +197,7 @@ void ebsp_move(void* payload, int buffer_size) {
     if (m->nbytes < buffer_size)
         buffer_size = m->nbytes;
 
-    memcpy(payload, _pointer_to_arm(m->payload), buffer_size);
+    memcpy(payload, _e_to_arm_pointer(m->payload), buffer_size);
 }
 
 int ebsp_hpmove(void** tag_ptr_buf, void** payload_ptr_buf) {
@@ -140,8 +205,8 @@ int ebsp_hpmove(void** tag_ptr_buf, void** payload_ptr_buf) {
     _pop_queue_message();
     if (m == 0)
         return -1;
-    *tag_ptr_buf = _pointer_to_arm(m->tag);
-    *payload_ptr_buf = _pointer_to_arm(m->payload);
+    *tag_ptr_buf = _e_to_arm_pointer(m->tag);
+    *payload_ptr_buf = _e_to_arm_pointer(m->payload);
     return m->nbytes;
 }
 
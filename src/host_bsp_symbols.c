@@ -0,0 +1,314 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "host_bsp_private.h"
+#include <e-loader.h>
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Symbol lookup for ebsp_preload and ebsp_harvest, and the strings of the
+// program for the log of the cores (see _drain_logs)
+//
+// The symbol table is read from the ELF file of the e-program: the file
+// passed to bsp_init when it is an ELF file (as on the emulator), or else
+// the file with the same name and the extension .elf, which the Makefiles
+// build next to the .srec file. The file is kept in host memory until a
+// symbol of another file is requested.
+
+#if defined(EBSP_EMULATOR) && __SIZEOF_POINTER__ == 8
+// The emulator runs the e-program as a native shared object
+typedef Elf64_Ehdr _elf_ehdr;
+typedef Elf64_Shdr _elf_shdr;
+typedef Elf64_Sym _elf_sym;
+#else
+typedef Elf32_Ehdr _elf_ehdr;
+typedef Elf32_Shdr _elf_shdr;
+typedef Elf32_Sym _elf_sym;
+#endif
+
+typedef struct {
+    uintptr_t value;
+    size_t size;
+    int is_bss; // cleared by the program when it starts
+} _symbol_info;
+
+static struct {
+    char path[1024];
+    time_t mtime;
+    off_t file_size;
+    unsigned char* data;
+} elf_cache;
+
+static int _is_elf(const unsigned char* data, size_t size) {
+    return size >= sizeof(_elf_ehdr) && memcmp(data, ELFMAG, SELFMAG) == 0;
+}
+
+// Reads the whole file at `path` into the cache, unless it is already there
+static int _cache_elf(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return 0;
+    if (elf_cache.data != NULL && strcmp(elf_cache.path, path) == 0 &&
+        elf_cache.mtime == info.st_mtime &&
+        elf_cache.file_size == info.st_size)
+        return 1;
+
+    free(elf_cache.data);
+    memset(&elf_cache, 0, sizeof(elf_cache));
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return 0;
+    unsigned char* data = malloc(info.st_size);
+    int ok = data != NULL &&
+             fread(data, 1, info.st_size, file) == (size_t)info.st_size &&
+             _is_elf(data, info.st_size);
+    fclose(file);
+    if (!ok) {
+        free(data);
+        return 0;
+    }
+
+    snprintf(elf_cache.path, sizeof(elf_cache.path), "%s", path);
+    elf_cache.mtime = info.st_mtime;
+    elf_cache.file_size = info.st_size;
+    elf_cache.data = data;
+    return 1;
+}
+
+// Loads the ELF file that belongs to the e-program in the cache
+static int _cache_program_elf() {
+    if (_cache_elf(state.e_fullpath))
+        return 1;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s", state.e_fullpath);
+    char* extension = strrchr(path, '.');
+    if (extension == NULL || strcmp(extension, ".srec") != 0 ||
+        extension - path + sizeof(".elf") > sizeof(path))
+        return 0;
+    strcpy(extension, ".elf");
+    return _cache_elf(path);
+}
+
+// Searches the symbol table of the cached file, or the dynamic symbol
+// table when it was stripped
+static int _find_symbol(const char* name, _symbol_info* symbol) {
+    const unsigned char* data = elf_cache.data;
+    size_t file_size = elf_cache.file_size;
+    const _elf_ehdr* ehdr = (const _elf_ehdr*)data;
+    if (ehdr->e_shoff + ehdr->e_shnum * sizeof(_elf_shdr) > file_size)
+        return 0;
+    const _elf_shdr* shdrs = (const _elf_shdr*)(data + ehdr->e_shoff);
+
+    for (int type = SHT_SYMTAB;; type = SHT_DYNSYM) {
+        for (int i = 0; i < ehdr->e_shnum; i++) {
+            const _elf_shdr* table = &shdrs[i];
+            if (table->sh_type != type || table->sh_link >= ehdr->e_shnum)
+                continue;
+            const _elf_shdr* strings = &shdrs[table->sh_link];
+            if (table->sh_offset + table->sh_size > file_size ||
+                strings->sh_offset + strings->sh_size > file_size)
+                continue;
+
+            const _elf_sym* syms = (const _elf_sym*)(data + table->sh_offset);
+            const char* names = (const char*)(data + strings->sh_offset);
+            int count = table->sh_size / sizeof(_elf_sym);
+            for (int s = 0; s < count; s++) {
+                if (syms[s].st_shndx == SHN_UNDEF ||
+                    syms[s].st_shndx >= ehdr->e_shnum ||
+                    syms[s].st_name >= strings->sh_size ||
+                    strcmp(&names[syms[s].st_name], name) != 0)
+                    continue;
+                symbol->value = syms[s].st_value;
+                symbol->size = syms[s].st_size;
+                symbol->is_bss = shdrs[syms[s].st_shndx].sh_type == SHT_NOBITS;
+                return 1;
+            }
+        }
+        if (type == SHT_DYNSYM)
+            return 0;
+    }
+}
+
+// Returns the string at `address` on the cores when it is part of the
+// program image, such as a string literal, or NULL otherwise
+const char* _program_string(uintptr_t address) {
+    if (!_cache_program_elf())
+        return NULL;
+    const unsigned char* data = elf_cache.data;
+    size_t file_size = elf_cache.file_size;
+    const _elf_ehdr* ehdr = (const _elf_ehdr*)data;
+    if (ehdr->e_shoff + ehdr->e_shnum * sizeof(_elf_shdr) > file_size)
+        return NULL;
+    const _elf_shdr* shdrs = (const _elf_shdr*)(data + ehdr->e_shoff);
+
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        const _elf_shdr* section = &shdrs[i];
+        if (!(section->sh_flags & SHF_ALLOC) ||
+            section->sh_type == SHT_NOBITS || address < section->sh_addr ||
+            address >= section->sh_addr + section->sh_size ||
+            section->sh_offset + section->sh_size > file_size)
+            continue;
+        const char* string =
+            (const char*)(data + section->sh_offset + address -
+                          section->sh_addr);
+        size_t available = section->sh_addr + section->sh_size - address;
+        if (memchr(string, '\0', available) == NULL)
+            return NULL;
+        return string;
+    }
+    return NULL;
+}
+
+// Returns 1 when the `nbytes` bytes at `address` in the program image are
+// all part of sections with contents that are loaded, and equal `data`
+int _program_bytes_match(uintptr_t address, const unsigned char* data,
+                         size_t nbytes) {
+    if (!_cache_program_elf())
+        return 0;
+    const unsigned char* elf = elf_cache.data;
+    size_t file_size = elf_cache.file_size;
+    const _elf_ehdr* ehdr = (const _elf_ehdr*)elf;
+    if (ehdr->e_shoff + ehdr->e_shnum * sizeof(_elf_shdr) > file_size)
+        return 0;
+    const _elf_shdr* shdrs = (const _elf_shdr*)(elf + ehdr->e_shoff);
+
+    size_t matched = 0;
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        const _elf_shdr* section = &shdrs[i];
+        if (!(section->sh_flags & SHF_ALLOC) ||
+            section->sh_type == SHT_NOBITS ||
+            section->sh_offset + section->sh_size > file_size)
+            continue;
+        uintptr_t start = section->sh_addr;
+        uintptr_t end = section->sh_addr + section->sh_size;
+        if (start < address)
+            start = address;
+        if (end > address + nbytes)
+            end = address + nbytes;
+        if (start >= end)
+            continue;
+        if (memcmp(elf + section->sh_offset + (start - section->sh_addr),
+                   data + (start - address), end - start) != 0)
+            return 0;
+        matched += end - start;
+    }
+    return matched == nbytes;
+}
+
+// Returns the number of bytes of the sections with contents that are
+// loaded, which is the size of the program in an SREC file
+size_t _program_image_size() {
+    if (!_cache_program_elf())
+        return 0;
+    const unsigned char* elf = elf_cache.data;
+    size_t file_size = elf_cache.file_size;
+    const _elf_ehdr* ehdr = (const _elf_ehdr*)elf;
+    if (ehdr->e_shoff + ehdr->e_shnum * sizeof(_elf_shdr) > file_size)
+        return 0;
+    const _elf_shdr* shdrs = (const _elf_shdr*)(elf + ehdr->e_shoff);
+
+    size_t size = 0;
+    for (int i = 0; i < ehdr->e_shnum; i++)
+        if ((shdrs[i].sh_flags & SHF_ALLOC) &&
+            shdrs[i].sh_type != SHT_NOBITS)
+            size += shdrs[i].sh_size;
+    return size;
+}
+
+// Finds the address on the cores of `nbytes` bytes at `symbol`
+static int _symbol_address(const char* caller, int pid, const char* symbol,
+                           int nbytes, int writing, off_t* address) {
+    if (state.host_combuf_addr == NULL) {
+        fprintf(stderr, "ERROR: %s called before bsp_begin\n", caller);
+        return 0;
+    }
+    if (pid < 0 || pid >= state.nprocs_used) {
+        fprintf(stderr, "ERROR: %s called with pid = %d.\n", caller, pid);
+        return 0;
+    }
+    if (!_cache_program_elf()) {
+        fprintf(stderr, "ERROR: %s could not read the symbols of %s.\n",
+                caller, state.e_fullpath);
+        return 0;
+    }
+
+    _symbol_info info;
+#ifdef EBSP_EMULATOR
+    int found = _find_symbol(symbol, &info);
+#else
+    // The Epiphany toolchain adds a leading underscore to C symbols
+    char name[256];
+    snprintf(name, sizeof(name), "_%s", symbol);
+    int found = _find_symbol(name, &info) || _find_symbol(symbol, &info);
+#endif
+    if (!found) {
+        fprintf(stderr, "ERROR: %s could not find symbol %s.\n", caller,
+                symbol);
+        return 0;
+    }
+    if (nbytes < 0 || (size_t)nbytes > info.size) {
+        fprintf(stderr, "ERROR: %s called with %d bytes for symbol %s of %d "
+                        "bytes.\n",
+                caller, nbytes, symbol, (int)info.size);
+        return 0;
+    }
+    if (writing && info.is_bss) {
+        fprintf(stderr, "ERROR: %s can not write symbol %s, because it is "
+                        "cleared when the program starts. Give it a "
+                        "nonzero initial value.\n",
+                caller, symbol);
+        return 0;
+    }
+
+#ifdef EBSP_EMULATOR
+    *address = (off_t)e_emu_program_address(info.value);
+#else
+    if (info.value + nbytes > LOCAL_MEMORY_SIZE) {
+        fprintf(stderr, "ERROR: %s can only access symbols in local memory, "
+                        "%s is not.\n",
+                caller, symbol);
+        return 0;
+    }
+    *address = info.value;
+#endif
+    return 1;
+}
+
+int ebsp_preload(int pid, const char* symbol, const void* buf, int nbytes) {
+    off_t address;
+    if (!_symbol_address("ebsp_preload", pid, symbol, nbytes, 1, &address))
+        return 0;
+    return ebsp_write(pid, (void*)buf, address, nbytes);
+}
+
+int ebsp_harvest(int pid, const char* symbol, void* buf, int nbytes) {
+    off_t address;
+    if (!_symbol_address("ebsp_harvest", pid, symbol, nbytes, 0, &address))
+        return 0;
+    return ebsp_read(pid, address, buf, nbytes);
+}
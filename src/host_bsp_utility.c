@@ -25,6 +25,8 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include <stdio.h>
 #include <string.h>
 #include <stddef.h>
+#include <sched.h> // sched_yield
+#include <pthread.h>
 
 #include <unistd.h> // readlink, for getting the path to the executable
 
@@ -36,25 +38,33 @@ void ebsp_set_end_callback(void (*cb)()) { state.end_callback = cb; }
 // Used for pointers returned from ebsp_ext_malloc
 
 void* _arm_to_e_pointer(void* ptr) {
-    return (void*)((unsigned)ptr - (unsigned)state.host_combuf_addr +
+    return (void*)((uintptr_t)ptr - (uintptr_t)state.host_combuf_addr +
                    E_COMBUF_ADDR);
 }
 
 void* _e_to_arm_pointer(void* ptr) {
-    return (void*)((unsigned)ptr - E_COMBUF_ADDR +
-                   (unsigned)state.host_combuf_addr);
+    return (void*)((uintptr_t)ptr - E_COMBUF_ADDR +
+                   (uintptr_t)state.host_combuf_addr);
 }
 
-void _update_remote_timer() {
-    // Current time. Repeat these lines every iteration
+// Publish the current host time to the cores
+// The cores only read it when they start and after an ebsp_host_sync,
+// in between they use their own timer
+void _update_host_epoch() {
     clock_gettime(CLOCK_MONOTONIC, &state.ts_end);
 
-    float time_elapsed =
-        (state.ts_end.tv_sec - state.ts_start.tv_sec +
-         (state.ts_end.tv_nsec - state.ts_start.tv_nsec) * 1.0e-9);
+    long sec = state.ts_end.tv_sec - state.ts_start.tv_sec;
+    long nsec = state.ts_end.tv_nsec - state.ts_start.tv_nsec;
+    if (nsec < 0) {
+        sec -= 1;
+        nsec += 1000000000;
+    }
+    state.combuf->host_epoch_sec = sec;
+    state.combuf->host_epoch_nsec = nsec;
 
-    _write_extmem(&time_elapsed, offsetof(ebsp_combuf, remotetimer),
-                  sizeof(float));
+    // host_epoch_sec and host_epoch_nsec are adjacent
+    _write_extmem(&state.combuf->host_epoch_sec,
+                  offsetof(ebsp_combuf, host_epoch_sec), 2 * sizeof(uint32_t));
 }
 
 //------------------
@@ -69,6 +79,135 @@ void _microsleep(int microseconds) {
         fprintf(stderr, "ERROR: clock_nanosleep was interrupted.\n");
 }
 
+// The polling engine of ebsp_spmd
+// Right after the cores changed state, another change is likely to follow
+// soon (e.g. the next ebsp_host_sync), so the host spins first. When nothing
+// happens it backs off in stages so that a long running kernel does not keep
+// an ARM core busy.
+void _poll_reset() {
+    state.poll_idle = 0;
+    state.poll_sleep_us = 1;
+}
+
+void _poll_backoff() {
+    state.poll_idle++;
+    if (state.poll_idle < POLL_SPIN_ITERATIONS)
+        return;
+
+    if (state.poll_idle < POLL_SPIN_ITERATIONS + POLL_YIELD_ITERATIONS) {
+        sched_yield();
+        return;
+    }
+
+    _microsleep(state.poll_sleep_us);
+    if (state.poll_sleep_us < POLL_MAX_SLEEP_US)
+        state.poll_sleep_us *= 2;
+}
+
+// Host worker threads
+// The calling thread and the threads of state.workers take the next index
+// from a shared counter until all indices of the job are done
+static void _work(ebsp_worker_pool* pool) {
+    for (;;) {
+        int i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (i >= pool->count)
+            break;
+        pool->fn(pool->arg, i);
+    }
+}
+
+static void* _worker_thread(void* data) {
+    ebsp_worker_pool* pool = (ebsp_worker_pool*)data;
+    int job = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->job == job && !pool->stop)
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        if (pool->stop)
+            break;
+        job = pool->job;
+        pthread_mutex_unlock(&pool->mutex);
+        _work(pool);
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void _start_workers() {
+    ebsp_worker_pool* pool = &state.workers;
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (nthreads > MAX_WORKER_THREADS - 1)
+        nthreads = MAX_WORKER_THREADS - 1;
+    if (nthreads < 1)
+        return;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->stop = 0;
+    pool->job = 0;
+    for (; pool->nthreads < nthreads; pool->nthreads++)
+        if (pthread_create(&pool->threads[pool->nthreads], NULL,
+                           _worker_thread, pool) != 0)
+            break;
+    if (pool->nthreads == 0) {
+        pthread_mutex_destroy(&pool->mutex);
+        pthread_cond_destroy(&pool->wake);
+        pthread_cond_destroy(&pool->done);
+    }
+}
+
+// Stops the threads of state.workers, called by bsp_end
+void _stop_workers() {
+    ebsp_worker_pool* pool = &state.workers;
+    if (pool->nthreads == 0)
+        return;
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int t = 0; t < pool->nthreads; t++)
+        pthread_join(pool->threads[t], NULL);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    pool->nthreads = 0;
+}
+
+// Calls fn(arg, i) for i = 0, ..., count - 1, in parallel
+// The worker threads are kept between calls, so that a call per stream
+// does not create and join threads
+void _parallel_for(int count, void (*fn)(void*, int), void* arg) {
+    ebsp_worker_pool* pool = &state.workers;
+    if (count > 1 && pool->nthreads == 0)
+        _start_workers();
+    if (count <= 1 || pool->nthreads == 0) {
+        for (int i = 0; i < count; i++)
+            fn(arg, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->count = count;
+    pool->next = 0;
+    pool->running = pool->nthreads;
+    pool->job++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    _work(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
 void _get_p_coords(int pid, int* row, int* col) {
     (*row) = pid / state.cols;
     (*col) = pid % state.cols;
@@ -79,12 +218,15 @@ void _get_p_coords(int pid, int* row, int* col) {
 // It will include a trailing slash
 void init_application_path() {
     char path[1024];
-    if (readlink("/proc/self/exe", path, 1024) > 0) {
+    // readlink does not add a terminating 0
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length > 0) {
+        path[length] = 0;
         char* slash = strrchr(path, '/');
         if (slash) {
             int count = slash - path + 1;
             memcpy(state.e_directory, path, count);
-            state.e_directory[count + 1] = 0;
+            state.e_directory[count] = 0;
         }
     } else {
         fprintf(stderr, "ERROR: Could not find process directory.\n");
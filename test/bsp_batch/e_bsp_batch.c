@@ -0,0 +1,53 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+int main() {
+    bsp_begin();
+
+    int* chunk = 0;
+    ebsp_open_down_stream((void**)&chunk, 0);
+    int nbytes = ebsp_move_chunk_down((void**)&chunk, 0, 0);
+
+    // External memory of the run, while the host prepares the next one
+    int* result = ebsp_ext_malloc(4 * sizeof(int));
+    result[0] = bsp_pid();
+    result[1] = nbytes / sizeof(int);
+    result[2] = 0;
+    result[3] = 0;
+    for (int i = 0; i < nbytes / sizeof(int); i++)
+        result[0] += chunk[i];
+    ebsp_close_down_stream(0);
+
+    int* up = 0;
+    ebsp_open_up_stream((void**)&up, 1);
+    for (int i = 0; i < 4; i++)
+        up[i] = result[i];
+    ebsp_move_chunk_up((void**)&up, 1, 0);
+    ebsp_close_up_stream(1);
+    ebsp_free(result);
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+#define NBATCHES 4
+#define NINTS 16
+
+int data[NBATCHES][NINTS];
+int* results[NBATCHES][64];
+
+// Creates the streams of batch `b` while the previous batch is running
+void prepare_batch(int b) {
+    for (int i = 0; i < NINTS; i++)
+        data[b][i] = 100 * b + i;
+    for (int s = 0; s < bsp_nprocs(); s++) {
+        ebsp_create_down_stream(data[b], s, sizeof(data[b]), sizeof(data[b]));
+        results[b][s] =
+            ebsp_create_up_stream(s, 4 * sizeof(int), 4 * sizeof(int));
+    }
+}
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_batch.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    ebsp_set_batch_mode(1);
+    prepare_batch(0);
+
+    for (int b = 0; b < NBATCHES; b++) {
+        int run = ebsp_spmd_async();
+        if (b + 1 < NBATCHES)
+            prepare_batch(b + 1);
+
+        // Messages can not be staged while the cores run
+        if (b == 0) {
+            int tag = 0;
+            ebsp_send_down(0, &tag, &tag, sizeof(int));
+        }
+        // expect: (ERROR: ebsp_send_down called before the asynchronous run was finished with ebsp_spmd_wait.)
+
+        ebsp_spmd_wait(run);
+
+        // The results of batch b are kept while batch b + 1 is prepared
+        int sum = 0;
+        int counts = 1;
+        for (int s = 0; s < bsp_nprocs(); s++) {
+            sum += results[b][s][0];
+            counts &= (results[b][s][1] == NINTS);
+        }
+        printf("batch %d: sum %d, counts %s\n", b, sum, counts ? "ok" : "wrong");
+    }
+    // expect: (batch 0: sum 2040, counts ok)
+    // expect: (batch 1: sum 27640, counts ok)
+    // expect: (batch 2: sum 53240, counts ok)
+    // expect: (batch 3: sum 78840, counts ok)
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+// Sum of the ints in down stream `stream_id`
+int stream_sum(unsigned stream_id) {
+    int* chunk = 0;
+    ebsp_open_down_stream((void**)&chunk, stream_id);
+    int sum = 0;
+    int nbytes;
+    while ((nbytes = ebsp_move_chunk_down((void**)&chunk, stream_id, 0)) > 0)
+        for (int i = 0; i < nbytes / (int)sizeof(int); ++i)
+            sum += chunk[i];
+    ebsp_close_down_stream(stream_id);
+    return sum;
+}
+
+int main() {
+    bsp_begin();
+
+    int sum0 = stream_sum(0);
+    int sum1 = stream_sum(1);
+
+    // test: streams of ebsp_create_down_streams, which have different data
+    // and sizes on every core
+    EBSP_MSG_ORDERED("%i %i", sum0, sum1);
+    // expect_for_pid: ("%i %i" % (8386560 + 4096 * pid, 256 * (pid + 1)))
+
+    bsp_end();
+
+    return 0;
+}
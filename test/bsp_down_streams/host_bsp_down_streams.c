@@ -0,0 +1,67 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NINTS 4096
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_down_streams.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    int n = bsp_nprocs();
+
+    // Two streams for every core, created in a single call: the first one
+    // holds s, s + 1, ..., the second one a different number of ones
+    int* data = malloc(n * NINTS * sizeof(int));
+    int* ones = malloc(n * 256 * sizeof(int));
+    for (int s = 0; s < n; s++)
+        for (int i = 0; i < NINTS; i++)
+            data[s * NINTS + i] = s + i;
+    for (int i = 0; i < n * 256; i++)
+        ones[i] = 1;
+
+    const void** srcs = malloc(2 * n * sizeof(void*));
+    int* dst_core_ids = malloc(2 * n * sizeof(int));
+    int* nbytes = malloc(2 * n * sizeof(int));
+    for (int s = 0; s < n; s++) {
+        srcs[s] = &data[s * NINTS];
+        dst_core_ids[s] = s;
+        nbytes[s] = NINTS * sizeof(int);
+        srcs[n + s] = ones;
+        dst_core_ids[n + s] = s;
+        nbytes[n + s] = (s + 1) * 256 * sizeof(int);
+    }
+    ebsp_create_down_streams(2 * n, srcs, dst_core_ids, nbytes, 1024);
+    free(srcs);
+    free(dst_core_ids);
+    free(nbytes);
+    free(data);
+    free(ones);
+
+    ebsp_spmd();
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+int main() {
+    bsp_begin();
+    int s = bsp_pid();
+    int p = bsp_nprocs();
+
+    int left = -1;
+    bsp_push_reg(&left, sizeof(int));
+    bsp_sync();
+    bsp_put((s + 1) % p, &s, &left, 0, sizeof(int));
+    bsp_sync();
+
+    // test: the pids and the workgroup are the same in every run
+    EBSP_MSG_ORDERED("%i %i %i", s, p, left);
+    // expect_for_pid: ("%i 16 %i" % (pid, (pid - 1) % 16))
+    // expect_for_pid: ("%i 16 %i" % (pid, (pid - 1) % 16))
+
+    bsp_end();
+
+    return 0;
+}
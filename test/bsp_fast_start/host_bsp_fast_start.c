@@ -0,0 +1,45 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+// Runs the program twice in fast start mode. The second time the cores
+// are idle, so they are not reset and the cached program is written.
+int main(int argc, char** argv) {
+    ebsp_set_fast_start(1);
+
+    int ok = 1;
+    for (int run = 0; run < 2; run++) {
+        ok &= bsp_init("e_bsp_fast_start.srec", argc, argv);
+        ok &= bsp_begin(bsp_nprocs());
+        ok &= ebsp_spmd();
+        ok &= bsp_end();
+    }
+
+    ebsp_set_fast_start(0);
+
+    printf("runs succeeded: %i\n", ok);
+    // expect: (runs succeeded: 1)
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+int main() {
+    bsp_begin();
+    int s = bsp_pid();
+
+    // Core 0 prefetches the next chunk, core 1 and 2 do not
+    unsigned sum = 0;
+    unsigned count = 0;
+    if (s < 3) {
+        int* chunk = 0;
+        ebsp_open_down_stream((void**)&chunk, 0);
+        int nbytes;
+        while ((nbytes = ebsp_move_chunk_down((void**)&chunk, 0, s == 0)) > 0) {
+            for (int i = 0; i < nbytes / (int)sizeof(int); i++)
+                sum += chunk[i];
+            count += nbytes;
+        }
+        ebsp_close_down_stream(0);
+    }
+    if (s == 2)
+        ebsp_reset_down_cursor(0);
+    // expect: ($02: BSP ERROR: can not move the cursor of a stream that is refilled)
+    ebsp_barrier();
+    if (s == 0) {
+        int* chunk = 0;
+        if (ebsp_open_down_stream((void**)&chunk, 0) == 0)
+            ebsp_message("reopen refused");
+    }
+    // expect: ($00: BSP ERROR: can not open a stream that is refilled again)
+    // expect: ($00: reopen refused)
+    ebsp_barrier();
+
+    for (int i = 0; i < 3; i++) {
+        if (i == s)
+            ebsp_message("%u bytes, sum %u", count, sum);
+        ebsp_barrier();
+    }
+    // expect: ($00: 12582912 bytes, sum 4293394432)
+    // expect: ($01: 4000 bytes, sum 599500)
+    // expect: ($02: 12580912 bytes, sum 3506962682)
+
+    bsp_end();
+
+    return 0;
+}
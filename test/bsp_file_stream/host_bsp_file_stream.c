@@ -0,0 +1,54 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Larger than external memory, so that the stream gets a window
+#define NINTS (3 * 1024 * 1024)
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_file_stream.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    FILE* file = tmpfile();
+    int* data = malloc(NINTS * sizeof(int));
+    for (int i = 0; i < NINTS; i++)
+        data[i] = i;
+    fwrite(data, sizeof(int), NINTS, file);
+    fflush(file);
+    free(data);
+
+    long long nbytes = NINTS * sizeof(int);
+    int fd = fileno(file);
+    ebsp_create_down_stream_from_fd(fd, 0, nbytes, 0, 4096);
+    ebsp_create_down_stream_from_fd(fd, 400, 4000, 1, 1024);
+    ebsp_create_down_stream_from_fd(fd, 1000, nbytes - 2000, 2, 4000);
+    fclose(file);
+
+    ebsp_spmd();
+    bsp_end();
+
+    return 0;
+}
@@ -40,6 +40,9 @@ int main() {
         bsp_sync();
     // expect: ($02: BSP ERROR: multiple bsp_push_reg calls within one sync)
 
+    // Make sure every core has registered teststr before it is used
+    ebsp_barrier();
+
     if (bsp_pid() == 1) {
         bsp_hpput(0, &var, &var, 0, sizeof(int));
         bsp_hpput(0, &var, unregistered_var, 0, sizeof(int)); // Error
@@ -24,6 +24,17 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include <stdio.h>
 
 int main(int argc, char** argv) {
+    // Messages can not be sent before bsp_begin
+    int pid = 0;
+    int tag = 0;
+    int payload = 0;
+    const void* payloads[1] = {&payload};
+    int nbytes = sizeof(int);
+    ebsp_send_down(pid, &tag, &payload, nbytes);
+    // expect: (ERROR: ebsp_send_down called before bsp_begin.)
+    ebsp_send_down_many(1, &pid, &tag, payloads, &nbytes);
+    // expect: (ERROR: ebsp_send_down_many called before bsp_begin.)
+
     // initialize the BSP system
     if (!bsp_init("e_bsp_init.srec", argc, argv)) {
         fprintf(stderr, "[HELLO] bsp_init() failed\n");
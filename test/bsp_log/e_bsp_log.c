@@ -0,0 +1,86 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include <wchar.h>
+
+// Changed before it is printed, the host reads the memory of the core
+char greeting[] = "before";
+
+int main() {
+    bsp_begin();
+
+    if (bsp_pid() == 0) {
+        ebsp_log("int %d, negative %i, hex %x, char %c", 42, -7, 255, 'z');
+        // expect: ($00: int 42, negative -7, hex ff, char z)
+        ebsp_log("%d then %.2f and %.1e", 5, 3.14159, 0.001);
+        // expect: ($00: 5 then 3.14 and 1.0e-03)
+        ebsp_log("%lld %u 100%%", (long long)1 << 40, 3u);
+        // expect: ($00: 1099511627776 3 100%)
+        ebsp_log("%5d|%-5d|%05.1f|%s", 12, 34, 2.5, "literal");
+        // expect: ($00:    12|34   |002.5|literal)
+        ebsp_log("%d %d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8, 9);
+        // expect: ($00: 1 2 3 4 5 6 7 8 9)
+        ebsp_log("%.2Lf %d %lc", (long double)1.25, 6, (wint_t)'w');
+        // expect: ($00: 1.25 6 w)
+        ebsp_log("%ls then %d", L"wide", 8);
+        // expect: ($00: %ls then 8)
+        ebsp_log("%d and %*d", 1, 3, 2);
+        // expect: ($00: 1 and   2)
+        ebsp_log("%-*d|%.*f|%.*f|", 4, 7, 2, 3.14159, -1, 2.5);
+        // expect: ($00: 7   |3.14|2.500000|)
+        ebsp_log("%.0f %.0f %.0f %.0f %.0f %.0f %.0f %.0f %.0f %.0f %.0f %.0f "
+                 "%.0f %.0f %.0f %.0f %.0f",
+                 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10.0, 11.0, 12.0,
+                 13.0, 14.0, 15.0, 16.0, 17.0);
+        // expect: ($00: 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 %.0f)
+    }
+
+    // Strings in external memory and in writable data
+    char* buffer = NULL;
+    if (bsp_pid() == 0) {
+        buffer = ebsp_ext_malloc(16);
+        ebsp_memcpy(buffer, "in extmem", 10);
+        ebsp_log("%s", buffer);
+        // expect: ($00: in extmem)
+        ebsp_memcpy(greeting, "after", 6);
+        ebsp_log("%s", greeting);
+        // expect: ($00: after)
+    }
+    bsp_sync();
+    if (buffer != NULL)
+        ebsp_free(buffer);
+
+    // The log of core 0 is printed before this message
+    if (bsp_pid() == 1)
+        ebsp_message("message after the log");
+    // expect: ($01: message after the log)
+
+    // Messages are formatted by the host as well
+    if (bsp_pid() == 1)
+        ebsp_message("%.2f %lld", 2.5, (long long)-1 << 33);
+    // expect: ($01: 2.50 -8589934592)
+
+    bsp_end();
+
+    return 0;
+}
@@ -91,6 +91,25 @@ int main()
         ebsp_message(globalPass ? "PASS" : "FAIL");
     // expect: ($00: PASS)
 
+    // Symmetric allocation after a different number of local allocations
+    char* before[3];
+    for (int i = 0; i < s % 3; ++i)
+        before[i] = ebsp_malloc(64);
+    int* symbuffer = ebsp_sym_malloc(64 * sizeof(int));
+    int* nextbuffer = ebsp_sym_address((s + 1) % bsp_nprocs(), symbuffer);
+    nextbuffer[63] = s;
+    ebsp_barrier();
+    EBSP_MSG_ORDERED("%d", symbuffer[63]);
+    // expect_for_pid: ((pid - 1) % 16)
+    ebsp_free(symbuffer);
+    for (int i = 0; i < s % 3; ++i)
+        ebsp_free(before[i]);
+
+    // A symmetric allocation that does not fit fails on every core
+    void* toolarge = ebsp_sym_malloc(0x8000);
+    EBSP_MSG_ORDERED("%d", toolarge == 0);
+    // expect_for_pid: (1)
+
     bsp_end();
 
     return 0;
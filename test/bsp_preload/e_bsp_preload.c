@@ -0,0 +1,46 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+// Written by the host before the program starts and at the host sync
+int input[4] = {1, 1, 1, 1};
+
+// Read by the host
+int result = 0;
+int later_result;
+
+int main() {
+    bsp_begin();
+
+    for (int i = 0; i < 4; i++)
+        result += input[i];
+
+    ebsp_host_sync();
+
+    for (int i = 0; i < 4; i++)
+        later_result += result + input[i];
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+void sync_callback() {
+    int result = 0;
+    ebsp_harvest(1, "result", &result, sizeof(int));
+    printf("result of core 1 at the host sync: %d\n", result);
+
+    int input[4] = {10, 10, 10, 10};
+    for (int s = 0; s < bsp_nprocs(); s++)
+        ebsp_preload(s, "input", input, sizeof(input));
+}
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_preload.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    int n = bsp_nprocs();
+    for (int s = 0; s < n; s++) {
+        int input[4] = {s, s, s, s};
+        ebsp_preload(s, "input", input, sizeof(input));
+    }
+
+    // Errors: unknown symbol, too many bytes and a variable in .bss
+    int big[5] = {0};
+    ebsp_preload(0, "no_such_variable", big, sizeof(int));
+    // expect: (ERROR: ebsp_preload could not find symbol no_such_variable.)
+    ebsp_preload(0, "input", big, sizeof(big));
+    // expect: (ERROR: ebsp_preload called with 20 bytes for symbol input of 16 bytes.)
+    ebsp_preload(0, "later_result", big, sizeof(int));
+    // expect: (ERROR: ebsp_preload can not write symbol later_result, because it is cleared when the program starts. Give it a nonzero initial value.)
+
+    ebsp_set_sync_callback(sync_callback);
+    ebsp_spmd();
+    // expect: (result of core 1 at the host sync: 4)
+
+    int sum = 0;
+    for (int s = 0; s < n; s++) {
+        int result = 0;
+        ebsp_harvest(s, "later_result", &result, sizeof(int));
+        sum += result;
+    }
+    printf("sum of results: %d\n", sum);
+    // expect: (sum of results: 2560)
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+int main() {
+    bsp_begin();
+
+    // Sum of the message from the host and the chunk of the down stream
+    int value = 0;
+
+    int packets = 0;
+    int accum_bytes = 0;
+    bsp_qsize(&packets, &accum_bytes);
+    for (int i = 0; i < packets; i++) {
+        int status = 0;
+        int tag = 0;
+        int payload = 0;
+        bsp_get_tag(&status, &tag);
+        bsp_move(&payload, sizeof(int));
+        value += payload;
+    }
+
+    int* chunk = 0;
+    ebsp_open_down_stream((void**)&chunk, 0);
+    int nbytes = ebsp_move_chunk_down((void**)&chunk, 0, 0);
+    for (int i = 0; i < nbytes / sizeof(int); i++)
+        value += chunk[i];
+    ebsp_close_down_stream(0);
+
+    // Clears the messages from the host
+    bsp_sync();
+
+    int tag = bsp_pid();
+    ebsp_send_up(&tag, &value, sizeof(int));
+
+    bsp_end();
+
+    return 0;
+}
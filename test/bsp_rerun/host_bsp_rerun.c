@@ -0,0 +1,83 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+// Runs the same program three times with different input,
+// without loading it again. The second run is asynchronous.
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_rerun.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    int n = bsp_nprocs();
+
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+
+    int chunk_size = 4 * sizeof(int);
+    int downdata[4];
+
+    for (int run = 0; run < 3; run++) {
+        for (int s = 0; s < n; s++) {
+            int tag = s;
+            int payload = 100 * run + s;
+            ebsp_send_down(s, &tag, &payload, sizeof(int));
+        }
+
+        for (int i = 0; i < 4; i++)
+            downdata[i] = run + i;
+        for (int s = 0; s < n; s++)
+            ebsp_create_down_stream(downdata, s, chunk_size, chunk_size);
+
+        if (run == 1) {
+            int handle = ebsp_spmd_async();
+            while (ebsp_spmd_test(handle) == 0)
+                continue;
+            ebsp_spmd_wait(handle);
+        } else {
+            ebsp_spmd();
+        }
+
+        int packets = 0;
+        int accum_bytes = 0;
+        ebsp_qsize(&packets, &accum_bytes);
+
+        int sum = 0;
+        for (int i = 0; i < packets; i++) {
+            int status = 0;
+            int tag = 0;
+            int payload = 0;
+            ebsp_get_tag(&status, &tag);
+            ebsp_move(&payload, sizeof(int));
+            sum += payload;
+        }
+        printf("run %d: %d packets, sum %d\n", run, packets, sum);
+    }
+    // expect: (run 0: 16 packets, sum 216)
+    // expect: (run 1: 16 packets, sum 1880)
+    // expect: (run 2: 16 packets, sum 3544)
+
+    bsp_end();
+
+    return 0;
+}
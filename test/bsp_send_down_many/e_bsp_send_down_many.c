@@ -0,0 +1,56 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+int main() {
+    bsp_begin();
+
+    int packets = 0;
+    int accum_bytes = 0;
+    bsp_qsize(&packets, &accum_bytes);
+
+    // test: the batch is added after the single message,
+    // and the batch that did not fit is not sent
+    EBSP_MSG_ORDERED("packets: %i, bytes: %i", packets, accum_bytes);
+    // expect_for_pid: ("packets: 3, bytes: 16")
+
+    int payload[4] = {0};
+    int offset[3] = {0, 1, 2};
+    int payload_size = 0;
+    int tag = 0;
+    for (int i = 0; i < packets; ++i) {
+        bsp_get_tag(&payload_size, &tag);
+        bsp_move(&payload[offset[tag]], payload_size);
+    }
+
+    // test: messages of a batch arrive at the right core with their own
+    // tag, payload and size
+    EBSP_MSG_ORDERED("%i %i %i %i", payload[0], payload[1], payload[2],
+                     payload[3]);
+    // expect_for_pid: ("%i %i %i %i" % (1000 + pid, 2000 + pid, pid, 10 * pid))
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_send_down_many.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    int n = bsp_nprocs();
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+
+    // A single message first, so that the batch is added after it
+    for (int s = 0; s < n; ++s) {
+        int tag = 0;
+        int payload = 1000 + s;
+        ebsp_send_down(s, &tag, &payload, sizeof(int));
+    }
+
+    // Two messages for every core in one batch, with different sizes
+    int pids[2 * 64];
+    int tags[2 * 64];
+    const void* payloads[2 * 64];
+    int nbytes[2 * 64];
+    int ints[64];
+    int pairs[64][2];
+    for (int s = 0; s < n; ++s) {
+        ints[s] = 2000 + s;
+        pairs[s][0] = s;
+        pairs[s][1] = 10 * s;
+
+        pids[2 * s] = s;
+        tags[2 * s] = 1;
+        payloads[2 * s] = &ints[s];
+        nbytes[2 * s] = sizeof(int);
+
+        pids[2 * s + 1] = s;
+        tags[2 * s + 1] = 2;
+        payloads[2 * s + 1] = pairs[s];
+        nbytes[2 * s + 1] = sizeof(pairs[s]);
+    }
+    ebsp_send_down_many(2 * n, pids, tags, payloads, nbytes);
+
+    ebsp_spmd();
+
+    // A batch of more than MAX_MESSAGES (256) messages is not sent at all,
+    // so the cores find no messages in the next run
+    int many_pids[257];
+    int many_tags[257];
+    const void* many_payloads[257];
+    int many_nbytes[257];
+    for (int i = 0; i < 257; ++i) {
+        many_pids[i] = i % n;
+        many_tags[i] = 3;
+        many_payloads[i] = &ints[0];
+        many_nbytes[i] = sizeof(int);
+    }
+    ebsp_send_down_many(257, many_pids, many_tags, many_payloads, many_nbytes);
+    // expect: (ERROR: Maximal message count reached in ebsp_send_down_many.)
+
+    ebsp_spmd();
+    // expect_for_pid: ("packets: 0, bytes: 0")
+    // expect_for_pid: ("0 0 0 0")
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+
+// More than the window of a stream, so that the slots are reused
+#define NCHUNKS 1024
+#define CHUNK_INTS 1024
+
+int main() {
+    bsp_begin();
+    int s = bsp_pid();
+
+    // Core 0 prefetches the next chunk, core 1 does not
+    if (s < 2) {
+        int* chunk = 0;
+        ebsp_open_up_stream((void**)&chunk, 0);
+        for (int c = 0; c < NCHUNKS; c++) {
+            // The last chunk is only half full
+            int n = (c == NCHUNKS - 1) ? CHUNK_INTS / 2 : CHUNK_INTS;
+            for (int i = 0; i < n; i++)
+                chunk[i] = c * CHUNK_INTS + i;
+            ebsp_set_up_chunk_size(0, n * sizeof(int));
+            ebsp_move_chunk_up((void**)&chunk, 0, s == 0);
+        }
+        ebsp_close_up_stream(0);
+    }
+
+    // The host emptied the window already
+    if (s == 1) {
+        int* chunk = 0;
+        if (ebsp_open_up_stream((void**)&chunk, 0) == 0)
+            ebsp_message("reopen refused");
+    }
+    // expect: ($01: BSP ERROR: can not open a stream that is emptied again)
+    // expect: ($01: reopen refused)
+
+    bsp_end();
+
+    return 0;
+}
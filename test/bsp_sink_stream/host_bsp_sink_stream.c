@@ -0,0 +1,75 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NCHUNKS 1024
+#define CHUNK_INTS 1024
+#define NINTS ((NCHUNKS - 1) * CHUNK_INTS + CHUNK_INTS / 2)
+
+// Counts the ints that arrive in order
+void count_in_order(int pid, const void* data, int nbytes, void* arg) {
+    int* count = (int*)arg;
+    const int* values = (const int*)data;
+    for (int i = 0; i < nbytes / (int)sizeof(int); i++)
+        if (values[i] == *count)
+            (*count)++;
+}
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_sink_stream.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    FILE* file = tmpfile();
+    int count = 0;
+    ebsp_create_up_stream_to_fd(0, fileno(file), CHUNK_INTS * sizeof(int));
+    ebsp_create_up_stream_to_callback(1, count_in_order, &count,
+                                      CHUNK_INTS * sizeof(int));
+
+    ebsp_spmd();
+
+    // After the run, so that it is printed after the messages of the cores
+    ebsp_create_up_stream_to_fd(2, -1, CHUNK_INTS * sizeof(int));
+    // expect: (ERROR: invalid file descriptor in ebsp_create_up_stream_to_fd)
+
+    int* data = malloc(NINTS * sizeof(int) + 1);
+    rewind(file);
+    int nread = fread(data, 1, NINTS * sizeof(int) + 1, file);
+    int file_count = 0;
+    for (int i = 0; i < nread / (int)sizeof(int); i++)
+        if (data[i] == i)
+            file_count++;
+    free(data);
+    fclose(file);
+
+    // expect: (file: 4192256 bytes, 1048064 in order)
+    printf("file: %d bytes, %d in order\n", nread, file_count);
+    // expect: (callback: 1048064 in order)
+    printf("callback: %d in order\n", count);
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include <e-lib.h>
+
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+    int n = bsp_nprocs();
+
+    // Every core sends its pid to the next one
+    int received = -1;
+    bsp_push_reg(&received, sizeof(int));
+    bsp_sync();
+    bsp_put((p + 1) % n, &p, &received, 0, sizeof(int));
+    bsp_sync();
+
+    int result[3] = {received, e_group_config.group_rows,
+                     e_group_config.group_cols};
+    ebsp_send_up(&p, result, sizeof(result));
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+// Runs the program on a number of cores that is smaller than the chip,
+// with full rows of cores and with unused cores in the last row
+static void run(int nprocs, int argc, char** argv) {
+    bsp_init("e_bsp_submesh.srec", argc, argv);
+    bsp_begin(nprocs);
+
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+
+    // The workgroup has cores after the last pid, but they have no streams
+    if (nprocs == 5) {
+        int data[4] = {0, 1, 2, 3};
+        ebsp_create_down_stream(data, nprocs, sizeof(data), sizeof(data));
+        if (ebsp_create_up_stream(nprocs, sizeof(data), sizeof(data)) == NULL)
+            printf("no up stream for pid %d\n", nprocs);
+    }
+
+    ebsp_spmd();
+
+    int packets = 0;
+    int accum_bytes = 0;
+    ebsp_qsize(&packets, &accum_bytes);
+
+    int sum = 0;
+    int result[3] = {0, 0, 0};
+    for (int i = 0; i < packets; i++) {
+        int status = 0;
+        int tag = 0;
+        ebsp_get_tag(&status, &tag);
+        ebsp_move(result, sizeof(result));
+        sum += result[0];
+    }
+    printf("nprocs %d: %d packets, workgroup %dx%d, sum %d\n", nprocs, packets,
+           result[1], result[2], sum);
+
+    bsp_end();
+}
+
+int main(int argc, char** argv) {
+    run(8, argc, argv);
+    // expect: (nprocs 8: 8 packets, workgroup 2x4, sum 28)
+    run(5, argc, argv);
+    // expect: (ERROR: ebsp_create_down_stream called with pid 5)
+    // expect: (ERROR: ebsp_get_buffered called with pid 5)
+    // expect: (no up stream for pid 5)
+    // expect: (nprocs 5: 5 packets, workgroup 2x4, sum 10)
+    run(4, argc, argv);
+    // expect: (nprocs 4: 4 packets, workgroup 1x4, sum 6)
+    return 0;
+}
@@ -42,7 +42,21 @@ int main() {
         ebsp_message("Time runs forward");
     // expect: ($00: Time runs forward)
 
+    // Host syncs before the first call to ebsp_host_time
+    for (int i = 0; i < 5; i++) {
+        volatile int busyloop = 10000;
+        while (busyloop--) {
+        };
+        ebsp_host_sync();
+    }
+    t_new = bsp_time();
     t_old = ebsp_host_time();
+    if (t_old < t_new)
+        ebsp_message("Host time behind core time? %f < %f", t_old, t_new);
+    else if (bsp_pid() == 0)
+        ebsp_message("Host time after host sync");
+    // expect: ($00: Host time after host sync)
+
     backward = 0;
     for (int i = 0; i < 30; i++) {
         bsp_sync();
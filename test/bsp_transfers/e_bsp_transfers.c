@@ -0,0 +1,57 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+// Written by the host at the first host sync
+int data[4];
+int common[2];
+
+// Read by the host, so that it knows where to write
+int* data_address = 0;
+int* common_address = 0;
+
+int main() {
+    bsp_begin();
+
+    data_address = data;
+    common_address = common;
+    ebsp_host_sync();
+
+    // test: ebsp_writev writes a different buffer to every core
+    EBSP_MSG_ORDERED("%i %i %i %i", data[0], data[1], data[2], data[3]);
+    // expect_for_pid: ("%i %i %i %i" % (10 * pid, 10 * pid + 1, 10 * pid + 2, 10 * pid + 3))
+
+    // test: ebsp_write_all writes the same buffer to every core
+    EBSP_MSG_ORDERED("%i %i", common[0], common[1]);
+    // expect_for_pid: ("7 8")
+
+    // The host reads this back with ebsp_readv
+    for (int i = 0; i < 4; i++)
+        data[i] += 100;
+    ebsp_host_sync();
+
+    bsp_end();
+
+    return 0;
+}
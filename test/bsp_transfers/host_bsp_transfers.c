@@ -0,0 +1,95 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Address of the IMASK register of a core
+#define REG_IMASK 0xf0424
+
+int host_syncs = 0;
+int readv_sum = 0;
+int register_result = 0;
+
+void sync_callback() {
+    int n = bsp_nprocs();
+    // The buffers are at the same address on every core
+    int* data_address = 0;
+    int* common_address = 0;
+    ebsp_harvest(0, "data_address", &data_address, sizeof(data_address));
+    ebsp_harvest(0, "common_address", &common_address,
+                 sizeof(common_address));
+
+    int buffers[n][4];
+    ebsp_transfer transfers[n];
+    for (int s = 0; s < n; s++) {
+        transfers[s].pid = s;
+        transfers[s].address = (off_t)(uintptr_t)data_address;
+        transfers[s].buffer = buffers[s];
+        transfers[s].size = sizeof(buffers[s]);
+    }
+
+    if (host_syncs++ == 0) {
+        for (int s = 0; s < n; s++)
+            for (int i = 0; i < 4; i++)
+                buffers[s][i] = 10 * s + i;
+        ebsp_writev(transfers, n);
+
+        int common[2] = {7, 8};
+        ebsp_write_all(common, (off_t)(uintptr_t)common_address,
+                       sizeof(common));
+        return;
+    }
+
+    ebsp_readv(transfers, n);
+    for (int s = 0; s < n; s++)
+        for (int i = 0; i < 4; i++)
+            readv_sum += buffers[s][i];
+
+    // The registers of a core are not in its mapped local memory, so
+    // these fall back to e_read and e_write. IMASK is written back unchanged
+    unsigned imask = 0;
+    ebsp_transfer reg = {0, REG_IMASK, &imask, sizeof(imask)};
+    register_result = ebsp_readv(&reg, 1);
+    register_result &= ebsp_writev(&reg, 1);
+}
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_transfers.srec", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    ebsp_set_sync_callback(sync_callback);
+    ebsp_spmd();
+
+    // test: ebsp_readv reads a buffer from every core
+    printf("sum read with ebsp_readv: %d\n", readv_sum);
+    // expect: (sum read with ebsp_readv: 11296)
+
+    // test: transfers outside of the local memory
+    printf("register read and written: %d\n", register_result);
+    // expect: (register read and written: 1)
+
+    bsp_end();
+
+    return 0;
+}
@@ -82,6 +82,124 @@ int main() {
     EBSP_MSG_ORDERED("%i", data);
     // expect_for_pid: ("4")
 
+    // test: many variables, of which some share an entry of the lookup table
+    static int many[32 * 16];
+    for (int i = 0; i < 32; ++i) {
+        bsp_push_reg(&many[16 * i], sizeof(int));
+        bsp_sync();
+    }
+    for (int i = 0; i < 32; ++i) {
+        data = 100 * i + s;
+        bsp_put((s + 1) % p, &data, &many[16 * i], 0, sizeof(int));
+        bsp_sync();
+    }
+    int sum = 0;
+    for (int i = 0; i < 32; ++i)
+        sum += many[16 * i];
+    EBSP_MSG_ORDERED("%i", sum);
+    // expect_for_pid: (49600 + 32 * ((pid - 1) % 16))
+
+    // test: puts with a staging buffer for 4 of the 8 payloads,
+    // which are stored 8-byte aligned
+    ebsp_set_put_staging(4 * 8);
+    for (int i = 0; i < 8; ++i) {
+        data = 1000 * i + s;
+        bsp_put((s + 1) % p, &data, &c, i * sizeof(int), sizeof(int));
+    }
+    bsp_sync();
+    sum = 0;
+    for (int i = 0; i < 8; ++i)
+        sum += c[i];
+    EBSP_MSG_ORDERED("%i", sum);
+    // expect_for_pid: (28000 + 8 * ((pid - 1) % 16))
+
+    // test: requests large enough to be done by the DMA, more of them
+    // than bsp_sync has descriptors, with a get that reads `big` before
+    // the puts of the same sync overwrite it
+    ebsp_set_sync_dma(64);
+    static int big[256];
+    static int buf[256];
+    for (int i = 0; i < 256; ++i) {
+        big[i] = s;
+        buf[i] = s;
+    }
+    bsp_push_reg(big, sizeof(big));
+    bsp_sync();
+    for (int i = 0; i < 8; ++i)
+        bsp_put((s + 1) % p, &buf[32 * i], big, 32 * i * sizeof(int),
+                32 * sizeof(int));
+    bsp_get((s + 2) % p, big, 0, buf, sizeof(buf));
+    bsp_sync();
+    sum = 0;
+    for (int i = 0; i < 256; ++i)
+        sum += big[i] + buf[i];
+    EBSP_MSG_ORDERED("%i", sum);
+    // expect_for_pid: (256 * ((pid + 15) % 16) + 256 * ((pid + 2) % 16))
+
+    // test: DMA requests with gaps between them, so that they are not merged
+    // and bsp_sync has to reuse its descriptors in both phases
+    for (int i = 0; i < 256; ++i) {
+        big[i] = s;
+        buf[i] = 1000 + s;
+    }
+    bsp_sync();
+    for (int i = 0; i < 8; ++i) {
+        bsp_put((s + 1) % p, &buf[32 * i], big, 32 * i * sizeof(int),
+                16 * sizeof(int));
+        bsp_get((s + 2) % p, big, (32 * i + 16) * sizeof(int),
+                &buf[32 * i + 16], 16 * sizeof(int));
+    }
+    bsp_sync();
+    sum = 0;
+    for (int i = 0; i < 256; ++i)
+        sum += big[i] + buf[i];
+    EBSP_MSG_ORDERED("%i", sum);
+    // expect_for_pid: (128 * (1000 + (pid + 15) % 16) + 128 * pid + 128 * (1000 + pid) + 128 * ((pid + 2) % 16))
+
+    // test: consecutive puts and gets are merged, so that more of them than
+    // MAX_DATA_REQUESTS fit in one sync. The payloads of the puts continue
+    // from the staging buffer into external memory
+    for (int i = 0; i < 256; ++i) {
+        buf[i] = i + s;
+        bsp_put((s + 1) % p, &buf[i], big, i * sizeof(int), sizeof(int));
+    }
+    bsp_sync();
+    for (int i = 0; i < 256; ++i)
+        bsp_get((s + 1) % p, big, i * sizeof(int), &buf[i], sizeof(int));
+    bsp_sync();
+    sum = 0;
+    for (int i = 0; i < 256; ++i)
+        sum += big[i] + buf[i];
+    EBSP_MSG_ORDERED("%i", sum);
+    // expect_for_pid: (65280 + 256 * ((pid + 15) % 16) + 256 * pid)
+
+    // test: a put that continues the destination of the previous put but
+    // not its payload is rejected when the request table is full, without
+    // taking space for its payload. Only core 0 puts, to core 1
+    ebsp_set_put_staging(8);
+    if (s == 0) {
+        // The last payload is in the staging buffer, the rejected one would
+        // be stored in external memory
+        for (int i = 0; i < 127; ++i)
+            bsp_put(1, buf, big, 0, 3 * sizeof(int));
+        bsp_put(1, buf, big, 0, sizeof(int));
+        bsp_put(1, buf, big, sizeof(int), 3 * sizeof(int));
+        // expect: ($00: BSP ERROR: too many bsp_put requests per sync)
+    }
+    bsp_sync();
+    if (s == 0) {
+        // The last payload is in external memory, the rejected one would
+        // be stored in the staging buffer, which therefore stays unused
+        for (int i = 0; i < 128; ++i)
+            bsp_put(1, buf, big, 0, 3 * sizeof(int));
+        bsp_put(1, buf, big, 3 * sizeof(int), sizeof(int));
+        // expect: ($00: BSP ERROR: too many bsp_put requests per sync)
+        if (ebsp_set_put_staging(8))
+            ebsp_message("staging buffer unused");
+        // expect: ($00: staging buffer unused)
+    }
+    bsp_sync();
+
     bsp_end();
 
     return 0;